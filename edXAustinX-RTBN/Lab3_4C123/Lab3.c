@@ -39,8 +39,10 @@
 #include "os.h"
 #include "../inc/Profile.h"
 #include "Texas.h"
+#include "stats.h"
+#include "dsp.h"
+#include "display.h"
 
-uint32_t sqrt32(uint32_t s);
 #define THREADFREQ 1000   // frequency in Hz of round robin scheduler
 
 //---------------- Global variables shared between tasks ----------------
@@ -49,16 +51,19 @@ uint32_t Steps;             // number of steps counted
 uint32_t Magnitude;         // will not overflow (3*1,023^2 = 3,139,587)
                             // Exponentially Weighted Moving Average
 uint32_t EWMA;              // https://en.wikipedia.org/wiki/Moving_average#Exponential_moving_average
+EWMAType MagnitudeFilter;   // keeps EWMA with more precision than EWMA itself
 uint16_t SoundData;         // raw data sampled from the microphone
-int32_t SoundAvg;
-
 uint32_t SoundRMS;          // Root Mean Square average of most recent sound samples
 uint32_t LightData;         // 100 lux
 int32_t TemperatureData;    // 0.1C
 // semaphores
-int32_t NewData;  // true when new numbers to display on top of LCD
-int32_t LCDmutex; // exclusive access to LCD
-int32_t I2Cmutex; // exclusive access to I2C
+MailboxType SoundBox; // blocks of sound samples from Task0 to Task5
+EventGroupType DisplayEvents; // what is new for the LCD, for Task5
+#define SOUNDEVENT 0x01     // Task0 posted a block to SoundBox
+#define STEPEVENT  0x02     // Task2 counted a step
+#define TEMPEVENT  0x04     // Task4 measured TemperatureData
+#define LIGHTEVENT 0x08     // Task6 measured LightData
+#define PLOTEVENT  0x10     // Task2 queued plot commands, the only flag Task5 waits for
 int ReDrawAxes = 0;         // non-zero means redraw axes on next display task
 
 enum plotstate{
@@ -82,8 +87,14 @@ enum plotstate PlotState = Accelerometer;
 
 //---------------- Task0 samples sound from microphone ----------------
 // Event thread run by OS in real time at 1000 Hz
-#define SOUNDRMSLENGTH 1000 // number of samples to collect before calculating RMS (may overflow if greater than 4104)
-int16_t SoundArray[SOUNDRMSLENGTH];
+#define SOUNDRMSLENGTH 1000 // number of samples to collect before calculating RMS (at most 65536, see StatsType)
+struct soundblock{
+  StatsType Stats;                // of Sample[], updated as each sample is stored
+  int16_t Sample[SOUNDRMSLENGTH]; // one second of microphone data
+};
+#define SOUNDBLOCKWORDS ((sizeof(struct soundblock)+3)/4)
+uint32_t SoundBlocks[3*SOUNDBLOCKWORDS]; // storage for SoundBox
+struct soundblock *SoundFill;            // block Task0 is filling
 // *********Task0_Init*********
 // initializes microphone
 // Task0 measures sound intensity
@@ -92,6 +103,8 @@ int16_t SoundArray[SOUNDRMSLENGTH];
 void Task0_Init(void){
   BSP_Microphone_Init();
   SoundRMS = 0;
+  SoundFill = OS_Mailbox_Init(&SoundBox, SoundBlocks, SOUNDBLOCKWORDS);
+  Stats_Init(&SoundFill->Stats);
 }
 // *********Task0*********
 // Periodic event thread runs in real time at 1000 Hz
@@ -99,19 +112,18 @@ void Task0_Init(void){
 // Inputs:  none
 // Outputs: none
 void Task0(void){
-  static int32_t soundSum = 0;
   static int time = 0;// units of microphone sampling rate
 
   TExaS_Task0();     // record system time in array, toggle virtual logic analyzer
   Profile_Toggle0(); // viewed by a real logic analyzer to know Task0 started
   BSP_Microphone_Input(&SoundData);
-  soundSum = soundSum + (int32_t)SoundData;
-  SoundArray[time] = SoundData;
+  SoundFill->Sample[time] = SoundData;
+  Stats_Add(&SoundFill->Stats, SoundData);
   time = time + 1;
   if(time == SOUNDRMSLENGTH){
-    SoundAvg = soundSum/SOUNDRMSLENGTH;
-    soundSum = 0;
-    OS_Signal(&NewData); // makes task5 run every 1 sec
+    SoundFill = OS_Mailbox_Post(&SoundBox);
+    OS_EventGroup_Set(&DisplayEvents, SOUNDEVENT); // task5 shows it every 1 sec
+    Stats_Init(&SoundFill->Stats);
     time = 0;
   }
 }
@@ -123,7 +135,7 @@ void Task0(void){
 // Event thread run by OS in real time at 10 Hz
 uint32_t LostTask1Data;     // number of times that the FIFO was full when acceleration data was ready
 uint16_t AccX, AccY, AccZ;  // returned by BSP as 10-bit numbers
-#define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 0 and 1,023. A higher ALPHA discounts older observations faster.
+#define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 1 and 1,024. A higher ALPHA discounts older observations faster.
                             // basic step counting algorithm is based on a forum post from
                             // http://stackoverflow.com/questions/16392142/android-accelerometer-profiling/16539643#16539643
 enum state{                 // the step counting algorithm cycles through four states
@@ -145,7 +157,8 @@ void Task1_Init(void){
   // initialize the exponential weighted moving average filter
   BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
   Magnitude = sqrt32(AccX*AccX + AccY*AccY + AccZ*AccZ);
-  EWMA = Magnitude;                // this is a guess; there are many options
+  Stats_EWMAInit(&MagnitudeFilter, ALPHA, Magnitude); // this is a guess; there are many options
+  EWMA = Magnitude;
   Steps = 0;
   LostTask1Data = 0;
 }
@@ -182,22 +195,23 @@ void Task1(void){uint32_t squared;
 #define TEMP_MAX 1023
 #define TEMP_MIN 0
 void drawaxes(void){
-  OS_Wait(&LCDmutex);
   if(PlotState == Accelerometer){
-    BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Mag", MAGCOLOR, "Ave", EWMACOLOR, ACCELERATION_MAX, ACCELERATION_MIN);
+    Display_Axes(AXISCOLOR, BGCOLOR, "Time", "Mag", MAGCOLOR, "Ave", EWMACOLOR, ACCELERATION_MAX, ACCELERATION_MIN);
   } else if(PlotState == Microphone){
-    BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Sound", SOUNDCOLOR, "", 0, SoundData+100, SoundData-100);
+    Display_Axes(AXISCOLOR, BGCOLOR, "Time", "Sound", SOUNDCOLOR, "", 0, SoundData+100, SoundData-100);
   } else if(PlotState == Temperature){
-    BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Temp", TEMPCOLOR, "", 0, TEMP_MAX, TEMP_MIN);
+    Display_Axes(AXISCOLOR, BGCOLOR, "Time", "Temp", TEMPCOLOR, "", 0, TEMP_MAX, TEMP_MIN);
   } else if(PlotState == Light){
-    BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Light", LIGHTCOLOR, "", 0, LIGHT_MAX, LIGHT_MIN);
+    Display_Axes(AXISCOLOR, BGCOLOR, "Time", "Light", LIGHTCOLOR, "", 0, LIGHT_MAX, LIGHT_MIN);
   }
-  OS_Signal(&LCDmutex);  ReDrawAxes = 0;
+  ReDrawAxes = 0;
 }
+uint32_t Task2Id;     // OS_Id of Task2, to look up its OS_DeadlineMisses
 void Task2(void){uint32_t data;
   uint32_t localMin;   // smallest measured magnitude since odd-numbered step detected
   uint32_t localMax;   // largest measured magnitude since even-numbered step detected
   uint32_t localCount; // number of measured magnitudes above local min or below local max
+  Task2Id = OS_Id();
   localMin = 1024;
   localMax = 0;
   localCount = 0;
@@ -207,7 +221,7 @@ void Task2(void){uint32_t data;
     TExaS_Task2();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle2(); // viewed by a real logic analyzer to know Task2 started
     Magnitude = sqrt32(data);
-    EWMA = (ALPHA*Magnitude + (1023 - ALPHA)*EWMA)/1024;
+    EWMA = Stats_EWMA(&MagnitudeFilter, Magnitude);
     if(AlgorithmState == LookingForMax){
       if(Magnitude > localMax){
         localMax = Magnitude;
@@ -227,6 +241,7 @@ void Task2(void){uint32_t data;
       } else if(Magnitude < (EWMA -  AVGOVERSHOOT)){
         // step detected
         Steps = Steps + 1;
+        OS_EventGroup_Set(&DisplayEvents, STEPEVENT);
         localMin = 1024;
         localCount = 0;
         AlgorithmState = LookingForMin;
@@ -250,6 +265,7 @@ void Task2(void){uint32_t data;
       } else if(Magnitude > (EWMA + AVGOVERSHOOT)){
         // step detected
         Steps = Steps + 1;
+        OS_EventGroup_Set(&DisplayEvents, STEPEVENT);
         localMax = 0;
         localCount = 0;
         AlgorithmState = LookingForMax;
@@ -259,19 +275,18 @@ void Task2(void){uint32_t data;
       drawaxes();
       ReDrawAxes = 0;
     }
-    OS_Wait(&LCDmutex);
     if(PlotState == Accelerometer){
-      BSP_LCD_PlotPoint(Magnitude, MAGCOLOR);
-      BSP_LCD_PlotPoint(EWMA, EWMACOLOR);
+      Display_PlotPoint(Magnitude, MAGCOLOR);
+      Display_PlotPoint(EWMA, EWMACOLOR);
     } else if(PlotState == Microphone){
-      BSP_LCD_PlotPoint(SoundData, SOUNDCOLOR);
+      Display_PlotPoint(SoundData, SOUNDCOLOR);
     } else if(PlotState == Temperature){
-      BSP_LCD_PlotPoint(TemperatureData, TEMPCOLOR);
+      Display_PlotPoint(TemperatureData, TEMPCOLOR);
     } else if(PlotState == Light){
-      BSP_LCD_PlotPoint(LightData, LIGHTCOLOR);
+      Display_PlotPoint(LightData, LIGHTCOLOR);
     }
-    BSP_LCD_PlotIncrement();
-    OS_Signal(&LCDmutex);
+    Display_PlotIncrement();
+    OS_EventGroup_Set(&DisplayEvents, PLOTEVENT); // Task5 draws them
   }
 }
 /* ****************************************** */
@@ -377,23 +392,24 @@ void Task3(void){
 // measures temperature
 // Inputs:  none
 // Outputs: none
-void Task4(void){int32_t voltData,tempData;
-  int done;
+int TempSensorEnd(void *result){ // I2C driver calls this until it returns 1
+  int32_t *data = result;        // sensor voltage, then temperature
+  return BSP_TempSensor_End(&data[0], &data[1]);
+}
+void Task4(void){int32_t tempData[2];
+  I2CRequestType request;
+  request.Start = &BSP_TempSensor_Start;
+  request.End = &TempSensorEnd;
+  request.Result = tempData;
+  request.Delay = 1000;  // waits about 1 sec
   while(1){
     TExaS_Task4();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle4(); // viewed by a real logic analyzer to know Task4 started
 
-    OS_Wait(&I2Cmutex);
-    BSP_TempSensor_Start();
-    OS_Signal(&I2Cmutex);
-    done = 0;
-    OS_Sleep(1000);    // waits about 1 sec
-    while(done == 0){
-      OS_Wait(&I2Cmutex);
-      done = BSP_TempSensor_End(&voltData, &tempData);
-      OS_Signal(&I2Cmutex);
-    }
-    TemperatureData = tempData/10000;
+    OS_I2C_Submit(&request);
+    OS_I2C_Wait(&request);
+    TemperatureData = tempData[1]/10000;
+    OS_EventGroup_Set(&DisplayEvents, TEMPEVENT);
   }
 }
 /* ****************************************** */
@@ -404,41 +420,53 @@ void Task4(void){int32_t voltData,tempData;
 /* ------------------------------------------ */
 //------- Task5 displays text on LCD -----------
 /* ------------------------------------------ */
-// If no data are lost, the main loop in Task5 runs exactly at 1 Hz, but not in real time
+// Task5 wakes once for each batch of plot commands from Task2, every 100 ms,
+// and then shows whatever values are new; it is the only thread that uses
+// the LCD, and Display_Flush sends only what changed
+// If no data are lost, the sound and time in Task5 update exactly at 1 Hz, but not in real time
 
 // *********Task5*********
 // Main thread scheduled by OS round robin preemptive scheduler
-// updates the text at the top and bottom of the LCD
+// updates the text at the top and bottom of the LCD, and draws the plot
 // Inputs:  none
 // Outputs: none
-void Task5(void){int32_t soundSum;
-  OS_Wait(&LCDmutex);
-  BSP_LCD_DrawString(0,  0, "Temp=",  TOPTXTCOLOR);
-  BSP_LCD_DrawString(0,  1, "Step=",  TOPTXTCOLOR);
-  BSP_LCD_DrawString(10, 0, "Light=", TOPTXTCOLOR);
-  BSP_LCD_DrawString(10, 1, "Sound=", TOPTXTCOLOR);
-  OS_Signal(&LCDmutex);
+uint32_t Task5Id;     // OS_Id of Task5, to look up its OS_DeadlineMisses
+void Task5(void){struct soundblock *sound; uint32_t events;
+  Task5Id = OS_Id();
+  Display_String(0,  0, "Temp=",  TOPTXTCOLOR);
+  Display_String(0,  1, "Step=",  TOPTXTCOLOR);
+  Display_String(10, 0, "Light=", TOPTXTCOLOR);
+  Display_String(10, 1, "Sound=", TOPTXTCOLOR);
   while(1){
-    OS_Wait(&NewData);
-    TExaS_Task5();     // records system time in array, toggles virtual logic analyzer
-    Profile_Toggle5(); // viewed by a real logic analyzer to know Task5 started
-    soundSum = 0;
-    for(int i=0; i<SOUNDRMSLENGTH; i=i+1){
-      soundSum = soundSum + (SoundArray[i] - SoundAvg)*(SoundArray[i] - SoundAvg);
+    events = OS_EventGroup_Wait(&DisplayEvents, PLOTEVENT, 0); // one release per Task2 sample
+    events |= OS_EventGroup_Clear(&DisplayEvents, SOUNDEVENT|STEPEVENT|TEMPEVENT|LIGHTEVENT);
+    if(events&SOUNDEVENT){
+      TExaS_Task5();     // records system time in array, toggles virtual logic analyzer
+      Profile_Toggle5(); // viewed by a real logic analyzer to know Task5 started
+      sound = OS_Mailbox_Accept(&SoundBox); // Task5 owns this block until its next accept
+      if(sound){
+        SoundRMS = Stats_RMS(&sound->Stats);  // no rescan of sound->Sample[]
+      }
+    }
+    if(events&TEMPEVENT){
+      Display_UFix2_1(5,  0, TemperatureData, TEMPCOLOR);
+    }
+    if(events&STEPEVENT){
+      Display_UDec4(5,  1, Steps,             MAGCOLOR);
+    }
+    if(events&LIGHTEVENT){
+      Display_UDec4(16, 0, LightData,         LIGHTCOLOR);
+    }
+    if(events&SOUNDEVENT){
+      Display_UDec4(16, 1, SoundRMS,          SOUNDCOLOR);
+      Display_UDec4(16,12, Time/10,           TOPNUMCOLOR);
     }
-    SoundRMS = sqrt32(soundSum/SOUNDRMSLENGTH);
-    OS_Wait(&LCDmutex);
-    BSP_LCD_SetCursor(5,  0); BSP_LCD_OutUFix2_1(TemperatureData, TEMPCOLOR);
-    BSP_LCD_SetCursor(5,  1); BSP_LCD_OutUDec4(Steps,             MAGCOLOR);
-    BSP_LCD_SetCursor(16, 0); BSP_LCD_OutUDec4(LightData,         LIGHTCOLOR);
-    BSP_LCD_SetCursor(16, 1); BSP_LCD_OutUDec4(SoundRMS,          SOUNDCOLOR);
-    BSP_LCD_SetCursor(16,12); BSP_LCD_OutUDec4(Time/10,           TOPNUMCOLOR);
 //debug code
     if(LostTask1Data){
-      BSP_LCD_SetCursor(0, 12); BSP_LCD_OutUDec4(LostTask1Data, BSP_LCD_Color565(255, 0, 0));
+      Display_UDec4(0, 12, LostTask1Data, BSP_LCD_Color565(255, 0, 0));
     }
 //end of debug code
-    OS_Signal(&LCDmutex);
+    Display_Flush();   // one burst of only the characters that changed
   }
 }
 /* ****************************************** */
@@ -451,23 +479,23 @@ void Task5(void){int32_t soundSum;
 // Task6 measures light intensity
 // Inputs:  none
 // Outputs: none
+int LightSensorEnd(void *result){ // I2C driver calls this until it returns 1
+  return BSP_LightSensor_End(result);
+}
 void Task6(void){ uint32_t lightData;
-  int done;
+  I2CRequestType request;
+  request.Start = &BSP_LightSensor_Start;
+  request.End = &LightSensorEnd;
+  request.Result = &lightData;
+  request.Delay = 800;   // waits about 0.8 sec
   while(1){
     TExaS_Task6();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle6(); // viewed by a real logic analyzer to know Task6 started
 
-    OS_Wait(&I2Cmutex);
-    BSP_LightSensor_Start();
-    OS_Signal(&I2Cmutex);
-    done = 0;
-    OS_Sleep(800);     // waits about 0.8 sec
-    while(done == 0){
-      OS_Wait(&I2Cmutex);
-      done = BSP_LightSensor_End(&lightData);
-      OS_Signal(&I2Cmutex);
-    }
+    OS_I2C_Submit(&request);
+    OS_I2C_Wait(&request);
     LightData = lightData/100;
+    OS_EventGroup_Set(&DisplayEvents, LIGHTEVENT);
   }
 }
 /* ****************************************** */
@@ -477,7 +505,10 @@ void Task6(void){ uint32_t lightData;
 //---------------- Task7 dummy function ----------------
 // *********Task7*********
 // Main thread scheduled by OS round robin preemptive scheduler
-// Task7 does nothing but never blocks or sleeps
+// Task7 does nothing; it counts seconds
+// It used to spin on WaitForInterrupt so that some thread was always
+// ready.  The OS idle thread does that now, and sleeping here lets the
+// OS stop the time slice interrupts while every other task waits.
 // Inputs:  none
 // Outputs: none
 uint32_t Count7;
@@ -485,7 +516,7 @@ void Task7(void){
   Count7 = 0;
   while(1){
     Count7++;
-    WaitForInterrupt();
+    OS_Sleep(1000);
   }
 }
 /* ****************************************** */
@@ -1235,7 +1266,7 @@ const unsigned short title2[] = {
 // Task2  plot on LCD    after Task1 finishes
 // Task3  switch/buzzer  periodically every 10 ms
 // Task4  temperature    periodically every 1 sec
-// Task5  numbers on LCD after Task0 runs SOUNDRMSLENGTH times
+// Task5  numbers on LCD after Task0 runs SOUNDRMSLENGTH times, or a step, temperature or light
 // Task6  light          periodically every 800 ms
 // Task7  dummy          no timing requirement
 // Remember that you must have exactly one main() function, so
@@ -1252,6 +1283,7 @@ int main(void){
   BSP_Buzzer_Init(0);
   BSP_LCD_Init();
   BSP_LCD_FillScreen(BSP_LCD_Color565(0, 0, 0));
+  Display_Init();  // knows the LCD is blank
 //  for(int i=0; i<70;i++){
 //   BSP_LCD_DrawBitmap(8,i,title2,110,44);
 //    BSP_Delay1ms(20);
@@ -1259,16 +1291,27 @@ int main(void){
   BSP_LightSensor_Init();
   BSP_TempSensor_Init();
   Time = 0;
-  OS_InitSemaphore(&NewData, 0);  // 0 means no data
-  OS_InitSemaphore(&LCDmutex, 1); // 1 means free
-  OS_InitSemaphore(&I2Cmutex, 1); // 1 means free
+  OS_EventGroup_Init(&DisplayEvents); // nothing new to display
   OS_FIFO_Init();                 // initialize FIFO used to send data between Task1 and Task2
   // Task 0 should run every 1ms
   OS_AddPeriodicEventThread(&Task0, 1);
   // Task 1 should run every 100ms
   OS_AddPeriodicEventThread(&Task1, 100);
   // Task2, Task3, Task4, Task5, Task6, Task7 are main threads
-  OS_AddThreads(&Task2, &Task3, &Task4, &Task5, &Task6, &Task7);
+  // Task2 must keep up with Task1, and Task5 with the sensors, so they run
+  // earliest deadline first, ahead of the others
+  // Each stack holds what the thread calls plus MINSTACKSIZE, the initial
+  // FRAMESIZE frame and the interrupts that run on it; together the stacks
+  // may take THREADSTACKWORDS (osconfig.h).  They stay at 100 words, as
+  // STACKSIZE, until OS_StackHighWater has been read on the board: host
+  // threads run on host stacks, so the host can not measure them
+  OS_AddEDFThread(&Task2, 100, 100, 100, 5000);   // every 100 ms, 5 ms of CPU
+  OS_AddEDFThread(&Task5, 100, 100, 100, 10000);  // paced by PLOTEVENT, every 100 ms, 10 ms of CPU
+  OS_AddThread(&Task3, 100, 15);
+  OS_AddThread(&Task4, 100, 15);
+  OS_AddThread(&Task6, 100, 15);
+  OS_AddThread(&Task7, 100, 15);
+  OS_I2C_Init();                  // driver thread for Task4 and Task6 sensor transactions
   // when grading change 1000 to 4-digit number from edX
   TExaS_Init(GRADER, 1941 );          // initialize the Lab 3 grader
 //  TExaS_Init(LOGICANALYZER, 1000); // initialize the Lab 3 logic analyzer
@@ -1279,15 +1322,236 @@ int main(void){
 /*          End of Step 6 Section             */
 /* ****************************************** */
 
-// Newton's method
-// s is an integer
-// sqrt(s) is an integer
-uint32_t sqrt32(uint32_t s){
-uint32_t t;   // t*t will become s
-int n;             // loop counter
-  t = s/16+1;      // initial guess
-  for(n = 16; n; --n){ // will finish
-    t = ((t*t+s)/t)/2;
+//---------------- Step 7 ----------------
+// Step 7 is not part of the lab: it measures the OS so changes to
+// os.c can be compared.  Each measurement is a histogram in Cortex M4
+// core clock cycles, read from the DWT cycle counter; look at the
+// *Hist variables in the debugger once BenchDone is 1.
+// Measurement  How
+// SwitchHist   BenchA/BenchB take turns with OS_Suspend, cycles from
+//              one thread's OS_Suspend to the other running
+// PingHist     BenchA OS_Signal to BenchB, BenchB OS_Signal back,
+//              cycles for the round trip
+// FifoHist     BenchA OS_Ring_Put as fast as it can, BenchB
+//              OS_Ring_Get; cycles between two gets
+// WakeHist     BenchTick OS_Signal to BenchA running
+// JitterHist   BenchTick every 1 ms, cycles it was early or late
+// StatsHist    Stats_Add on each of SOUNDRMSLENGTH microphone samples
+// BlockHist    Stats_AddBlock on the same samples, using dsp.c
+// BenchStatsErrors counts results of the two statistics paths that
+// differ, and DSP_Dot or DSP_Decimate results that differ from plain C
+// Remember that you must have exactly one main() function, so
+// to work on this step, you must rename all other main()
+// functions in this file.
+#ifndef DWT_CYCCNT           // debug and trace registers, unless CortexM.h has them
+#define DEMCR      (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL   (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT (*((volatile uint32_t *)0xE0001004))
+#endif
+#define BENCHMS    250       // msec spent on each measurement
+#define BENCHBINS  16        // Bin[i] counts samples of 2^i to 2^(i+1)-1 cycles
+#define BENCHBLOCKS 32       // blocks of samples put through each statistics path
+struct histogram{
+  uint32_t Count;
+  uint32_t Min;
+  uint32_t Max;
+  uint64_t Sum;              // Sum/Count is the average
+  uint32_t Bin[BENCHBINS];   // the last bin also counts everything larger
+};
+typedef struct histogram HistogramType;
+HistogramType SwitchHist, PingHist, FifoHist, WakeHist, JitterHist, StatsHist, BlockHist;
+enum benchphase{
+  PhaseIdle,
+  PhaseSwitch,
+  PhasePing,
+  PhaseFifo,
+  PhaseWake
+};
+volatile enum benchphase BenchPhase = PhaseIdle;
+int32_t BenchDone;            // 1 when every histogram is complete
+int32_t BenchGo;              // BenchA and BenchB start when signalled
+int32_t BenchPingSema, BenchPongSema, BenchWakeSema;
+RingType *BenchFifo;
+int16_t BenchSamples[SOUNDRMSLENGTH];
+int32_t BenchStatsErrors;     // blocks where the two statistics paths disagree,
+                              // and DSP_Dot or DSP_Decimate results unlike plain C
+#define BENCHFACTOR 7         // DSP_Decimate factor checked, leaves a partial group
+int16_t BenchDecimated[SOUNDRMSLENGTH/BENCHFACTOR]; // what DSP_Decimate should store
+volatile uint32_t BenchSwitchStart, BenchWakeStart;
+void Hist_Add(HistogramType *h, uint32_t cycles){
+  int i = 0;
+  if((h->Count == 0)||(cycles < h->Min)) h->Min = cycles;
+  if(cycles > h->Max) h->Max = cycles;
+  h->Count++;
+  h->Sum += cycles;
+  while((i < BENCHBINS-1)&&(cycles >= (2u<<i))){
+    i++;
+  }
+  h->Bin[i]++;
+}
+void BenchTick(void){ // event thread every 1 ms
+  static uint32_t last;
+  uint32_t now = DWT_CYCCNT;
+  uint32_t period = BSP_Clock_GetFreq()/1000;
+  if(last && (BenchPhase != PhaseIdle)){
+    Hist_Add(&JitterHist, (now-last > period) ? (now-last-period) : (period-(now-last)));
+  }
+  last = now;
+  if(BenchPhase == PhaseWake){
+    BenchWakeStart = DWT_CYCCNT;
+    OS_Signal(&BenchWakeSema);
+  }
+}
+void BenchSwitchLoop(void){ // run by both BenchA and BenchB
+  uint32_t now;
+  while(BenchPhase == PhaseSwitch){
+    DisableInterrupts();      // a time slice ending here would mix up the two
+    now = DWT_CYCCNT;
+    if(BenchSwitchStart){
+      Hist_Add(&SwitchHist, now-BenchSwitchStart);
+    }
+    BenchSwitchStart = DWT_CYCCNT;
+    EnableInterrupts();
+    OS_Suspend();
+  }
+}
+void BenchA(void){
+  uint32_t start, n = 0;
+  OS_Wait(&BenchGo);
+  BenchSwitchLoop();
+  while(BenchPhase == PhasePing){
+    start = DWT_CYCCNT;
+    OS_Signal(&BenchPingSema);
+    OS_Wait(&BenchPongSema);
+    Hist_Add(&PingHist, DWT_CYCCNT-start);
+  }
+  OS_Signal(&BenchPingSema);  // let BenchB out of its last wait
+  while(BenchPhase == PhaseFifo){
+    if(OS_Ring_Put(BenchFifo, n) == 0){
+      n++;
+    } else{
+      OS_Suspend();           // full, let BenchB drain it
+    }
+  }
+  OS_Ring_Put(BenchFifo, n);  // let BenchB out of its last get
+  while(1){
+    OS_Wait(&BenchWakeSema);
+    if(BenchPhase == PhaseWake){
+      Hist_Add(&WakeHist, DWT_CYCCNT-BenchWakeStart);
+    }
   }
-  return t;
 }
+void BenchB(void){
+  uint32_t last = 0, now;
+  OS_Wait(&BenchGo);
+  BenchSwitchLoop();
+  while(BenchPhase == PhasePing){
+    OS_Wait(&BenchPingSema);
+    OS_Signal(&BenchPongSema);
+  }
+  while(BenchPhase == PhaseFifo){
+    OS_Ring_Get(BenchFifo);
+    now = DWT_CYCCNT;
+    if(last){
+      Hist_Add(&FifoHist, now-last);
+    }
+    last = now;
+  }
+  while(1){
+    OS_Sleep(1000);           // done
+  }
+}
+void BenchStats(void){ // BenchControl runs this with the other threads done
+  StatsType one, block;
+  uint32_t start, i, k;
+  uint16_t mic;
+  int64_t dot;
+  int32_t sum;
+  int n;
+  for(i=0; i<SOUNDRMSLENGTH; i=i+1){
+    BSP_Microphone_Input(&mic);
+    BenchSamples[i] = mic;
+  }
+  for(n=0; n<BENCHBLOCKS; n=n+1){
+    DisableInterrupts();      // time only the statistics
+    start = DWT_CYCCNT;
+    Stats_Init(&one);
+    for(i=0; i<SOUNDRMSLENGTH; i=i+1){
+      Stats_Add(&one, BenchSamples[i]);
+    }
+    Hist_Add(&StatsHist, DWT_CYCCNT-start);
+    start = DWT_CYCCNT;
+    Stats_Init(&block);
+    Stats_AddBlock(&block, BenchSamples, SOUNDRMSLENGTH);
+    Hist_Add(&BlockHist, DWT_CYCCNT-start);
+    EnableInterrupts();
+    if((one.Sum != block.Sum)||(one.SumSquares != block.SumSquares)||
+       (one.Min != block.Min)||(one.Max != block.Max)){
+      BenchStatsErrors++;
+    }
+  }
+  // DSP_Dot and DSP_Decimate against plain C; the odd offset makes every
+  // other pair load unaligned, and decimating in place checks in == out
+  dot = 0;
+  for(i=0; i<SOUNDRMSLENGTH-1; i=i+1){
+    dot = dot + BenchSamples[i]*BenchSamples[i+1];
+  }
+  if(DSP_Dot(BenchSamples, BenchSamples+1, SOUNDRMSLENGTH-1) != dot){
+    BenchStatsErrors++;
+  }
+  for(i=0; i<SOUNDRMSLENGTH/BENCHFACTOR; i=i+1){
+    sum = 0;
+    for(k=0; k<BENCHFACTOR; k=k+1){
+      sum = sum + BenchSamples[i*BENCHFACTOR+k];
+    }
+    BenchDecimated[i] = sum/BENCHFACTOR;
+  }
+  if(DSP_Decimate(BenchSamples, SOUNDRMSLENGTH, BENCHFACTOR, BenchSamples) != SOUNDRMSLENGTH/BENCHFACTOR){
+    BenchStatsErrors++;
+  }
+  for(i=0; i<SOUNDRMSLENGTH/BENCHFACTOR; i=i+1){
+    if(BenchSamples[i] != BenchDecimated[i]){
+      BenchStatsErrors++;
+      break;
+    }
+  }
+}
+void BenchControl(void){ // highest priority, sleeps while the others measure
+  BenchPhase = PhaseSwitch;
+  OS_Signal(&BenchGo);
+  OS_Signal(&BenchGo);
+  OS_Sleep(BENCHMS);
+  BenchPhase = PhasePing;
+  OS_Sleep(BENCHMS);
+  BenchPhase = PhaseFifo;
+  OS_Sleep(BENCHMS);
+  BenchPhase = PhaseWake;
+  OS_Sleep(BENCHMS);
+  BenchPhase = PhaseIdle;
+  BenchStats();
+  BenchDone = 1;
+  while(1){
+    OS_Sleep(1000);
+  }
+}
+int main_bench(void){
+  OS_Init();
+  DEMCR |= 0x01000000;        // TRCENA, turns on the DWT
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= 0x00000001;     // CYCCNTENA, count core clock cycles
+  BSP_Microphone_Init();
+  OS_InitSemaphore(&BenchGo, 0);
+  OS_InitSemaphore(&BenchPingSema, 0);
+  OS_InitSemaphore(&BenchPongSema, 0);
+  OS_InitSemaphore(&BenchWakeSema, 0);
+  BenchFifo = OS_FIFO_Create(64);
+  OS_AddThread(&BenchControl, 128, 1);
+  OS_AddThread(&BenchA, 128, 2);
+  OS_AddThread(&BenchB, 128, 2);
+  OS_AddPeriodicEventThread(&BenchTick, 1);
+  OS_Launch(BSP_Clock_GetFreq()/THREADFREQ); // doesn't return, interrupts enabled in here
+  return 0;             // this never executes
+}
+/* ****************************************** */
+/*          End of Step 7 Section             */
+/* ****************************************** */
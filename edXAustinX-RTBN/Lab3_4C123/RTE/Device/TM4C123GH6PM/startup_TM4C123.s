@@ -240,6 +240,14 @@ Reset_Handler   PROC
                 IMPORT  __main
 ;                LDR     R0, =SystemInit
 ;                BLX     R0
+                IF      {TARGET_FPU_VFP}
+                LDR     R0, =0xE000ED88           ; CPACR
+                LDR     R1, [R0]
+                ORR     R1, R1, #0x00F00000       ; full access to CP10 and CP11, the FPU
+                STR     R1, [R0]                  ; before __main sets up FPSCR
+                DSB
+                ISB
+                ENDIF
                 LDR     R0, =__main
                 BX      R0
                 ENDP
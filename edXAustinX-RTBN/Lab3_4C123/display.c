@@ -0,0 +1,292 @@
+// display.c
+// Runs on LM4F120/TM4C123/MSP432
+// Batched LCD output for the Lab 3 tasks.  A frame buffer of the
+// 128 by 128 LCD would take all 32 kbytes of RAM, so only the text is
+// cached: 21 by 13 characters and their colors, as the threads want
+// them and as they are on the screen.  Plot commands can not be
+// diffed, they go through a queue in order.  Writers only hold
+// interrupts off while they copy a few bytes; Display_Flush makes
+// every BSP_LCD call, one BSP_LCD_DrawString per run of changed
+// characters of one color.
+
+#include <stdint.h>
+#include "../inc/BSP.h"
+#include "../inc/CortexM.h"
+#include "display.h"
+
+#define PLOTSIZE 32         // plot commands queued between flushes, a power of 2
+#define ALLROWS ((1<<DISPLAYROWS)-1)
+
+uint32_t DisplayCalls;      // BSP_LCD calls made by Display_Flush
+uint32_t DisplayChars;      // characters sent to the LCD
+uint32_t DisplayLostPlots;  // plot commands dropped because the queue was full
+
+static char     Want[DISPLAYROWS][DISPLAYCOLS];       // text the threads wrote
+static uint16_t WantColor[DISPLAYROWS][DISPLAYCOLS];
+static char     Shown[DISPLAYROWS][DISPLAYCOLS];      // text on the LCD, 0 if not known
+static uint16_t ShownColor[DISPLAYROWS][DISPLAYCOLS];
+static uint32_t DirtyRows;  // bit r set if row r of Want was written since it was flushed
+
+struct plotcommand{
+  int32_t  Data;
+  uint16_t Color;
+  uint16_t Increment;       // 1 for BSP_LCD_PlotIncrement, 0 for BSP_LCD_PlotPoint
+};
+static struct plotcommand Plots[PLOTSIZE];
+static uint32_t PlotPutI;   // next Plots[PlotPutI&(PLOTSIZE-1)] to fill
+static uint32_t PlotGetI;   // next Plots[PlotGetI&(PLOTSIZE-1)] to draw
+
+struct axes{
+  uint16_t AxisColor, BgColor;
+  char *XLabel, *YLabel1, *YLabel2;
+  uint16_t Label1Color, Label2Color;
+  int32_t YMax, YMin;
+};
+static struct axes Axes;    // parameters of the last Display_Axes
+static int AxesPending;     // 1 if Axes are not drawn yet
+
+// ******** Display_Init ************
+// Forget every queued command; the LCD must be
+// blank, as after BSP_LCD_FillScreen with black
+// Inputs:  none
+// Outputs: none
+void Display_Init(void){
+  uint32_t row, col;
+  for(row=0; row<DISPLAYROWS; row=row+1){
+    for(col=0; col<DISPLAYCOLS; col=col+1){
+      Want[row][col] = ' ';
+      Shown[row][col] = ' ';
+    }
+  }
+  DirtyRows = 0;
+  PlotPutI = PlotGetI = 0;
+  AxesPending = 0;
+  DisplayCalls = 0;
+  DisplayChars = 0;
+  DisplayLostPlots = 0;
+}
+
+// ******** Display_String ************
+// Write a string into the text cache, clipped at the right edge
+// Inputs:  column (0 to 20), row (0 to 12), string, 16-bit color
+// Outputs: none
+void Display_String(uint32_t col, uint32_t row, const char *pt, uint16_t color){
+  long sr;
+  if((row >= DISPLAYROWS) || (col >= DISPLAYCOLS)){
+    return;
+  }
+  sr = StartCritical();     // at most 21 characters
+  while(*pt && (col < DISPLAYCOLS)){
+    Want[row][col] = *pt;
+    WantColor[row][col] = color;
+    pt = pt + 1;
+    col = col + 1;
+  }
+  DirtyRows |= 1<<row;
+  EndCritical(sr);
+}
+
+// ******** Display_UDec4 ************
+// Write a number into the text cache as four characters,
+// right justified, like BSP_LCD_OutUDec4
+// Inputs:  column, row, n (values above 9999 show as 9999), 16-bit color
+// Outputs: none
+void Display_UDec4(uint32_t col, uint32_t row, uint32_t n, uint16_t color){
+  char text[5];
+  int i;
+  if(n > 9999){
+    n = 9999;
+  }
+  for(i=3; i>=0; i=i-1){
+    text[i] = (i == 3 || n) ? ('0' + n%10) : ' ';  // leading zeros are blank
+    n = n/10;
+  }
+  text[4] = 0;
+  Display_String(col, row, text, color);
+}
+
+// ******** Display_UFix2_1 ************
+// Write a fixed-point number into the text cache as four
+// characters dd.d, like BSP_LCD_OutUFix2_1
+// Inputs:  column, row, n in 0.1 units (values above 999 show as 99.9),
+//          16-bit color
+// Outputs: none
+void Display_UFix2_1(uint32_t col, uint32_t row, uint32_t n, uint16_t color){
+  char text[5];
+  if(n > 999){
+    n = 999;
+  }
+  text[0] = (n >= 100) ? ('0' + n/100) : ' ';
+  text[1] = '0' + (n/10)%10;
+  text[2] = '.';
+  text[3] = '0' + n%10;
+  text[4] = 0;
+  Display_String(col, row, text, color);
+}
+
+// ******** Display_Axes ************
+// Queue BSP_LCD_Drawaxes, replacing any axes and
+// plot commands that have not been drawn yet
+// Inputs:  the parameters of BSP_LCD_Drawaxes, the labels
+//          must stay valid until the next Display_Flush
+// Outputs: none
+void Display_Axes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin){
+  long sr;
+  sr = StartCritical();
+  Axes.AxisColor = axisColor;
+  Axes.BgColor = bgColor;
+  Axes.XLabel = xLabel;
+  Axes.YLabel1 = yLabel1;
+  Axes.Label1Color = label1Color;
+  Axes.YLabel2 = yLabel2;
+  Axes.Label2Color = label2Color;
+  Axes.YMax = ymax;
+  Axes.YMin = ymin;
+  AxesPending = 1;
+  PlotGetI = PlotPutI;      // the new axes would erase them anyway
+  EndCritical(sr);
+}
+
+// put one command in Plots, or count it lost if Plots is full
+static void PlotPut(int32_t data, uint16_t color, uint16_t increment){
+  long sr;
+  sr = StartCritical();
+  if(PlotPutI - PlotGetI >= PLOTSIZE){
+    DisplayLostPlots = DisplayLostPlots + 1;
+  } else{
+    Plots[PlotPutI&(PLOTSIZE-1)].Data = data;
+    Plots[PlotPutI&(PLOTSIZE-1)].Color = color;
+    Plots[PlotPutI&(PLOTSIZE-1)].Increment = increment;
+    PlotPutI = PlotPutI + 1;
+  }
+  EndCritical(sr);
+}
+
+// ******** Display_PlotPoint ************
+// Queue BSP_LCD_PlotPoint
+// Inputs:  data, 16-bit color
+// Outputs: none
+void Display_PlotPoint(int32_t data, uint16_t color){
+  PlotPut(data, color, 0);
+}
+
+// ******** Display_PlotIncrement ************
+// Queue BSP_LCD_PlotIncrement
+// Inputs:  none
+// Outputs: none
+void Display_PlotIncrement(void){
+  PlotPut(0, 0, 1);
+}
+
+// 1 if the character at row, col of the LCD is not c in color,
+// a space looks the same in any color
+static int Differs(uint32_t row, uint32_t col, char c, uint16_t color){
+  return (c != Shown[row][col]) || ((c != ' ') && (color != ShownColor[row][col]));
+}
+
+// ******** Display_Flush ************
+// Axes first, since they erase the plot and may draw over text,
+// then the plot commands in order, then for each row written since
+// the last flush, each run of characters that differ from Shown
+// and share a color (spaces take any color) in one DrawString
+// Inputs:  none
+// Outputs: number of BSP_LCD calls made
+uint32_t Display_Flush(void){
+  struct axes axes;
+  struct plotcommand plot;
+  char text[DISPLAYCOLS];   // one row of Want, copied
+  uint16_t color[DISPLAYCOLS];
+  char run[DISPLAYCOLS+1];
+  uint32_t calls = DisplayCalls;
+  uint32_t dirty, row, col, start, n;
+  uint16_t runColor;
+  int pending, blank;
+  long sr;
+  sr = StartCritical();
+  pending = AxesPending;
+  axes = Axes;
+  AxesPending = 0;
+  EndCritical(sr);
+  if(pending){
+    BSP_LCD_Drawaxes(axes.AxisColor, axes.BgColor, axes.XLabel, axes.YLabel1,
+      axes.Label1Color, axes.YLabel2, axes.Label2Color, axes.YMax, axes.YMin);
+    DisplayCalls = DisplayCalls + 1;
+    for(row=0; row<DISPLAYROWS; row=row+1){
+      for(col=0; col<DISPLAYCOLS; col=col+1){
+        if(Shown[row][col] != ' '){
+          Shown[row][col] = 0;  // may be drawn over, draw it again
+        }
+      }
+    }
+    sr = StartCritical();
+    DirtyRows = ALLROWS;
+    EndCritical(sr);
+  }
+  while(1){
+    sr = StartCritical();
+    if(AxesPending || (PlotGetI == PlotPutI)){
+      EndCritical(sr);      // commands after new axes wait for the next flush
+      break;
+    }
+    plot = Plots[PlotGetI&(PLOTSIZE-1)];
+    PlotGetI = PlotGetI + 1;
+    EndCritical(sr);
+    if(plot.Increment){
+      BSP_LCD_PlotIncrement();
+    } else{
+      BSP_LCD_PlotPoint(plot.Data, plot.Color);
+    }
+    DisplayCalls = DisplayCalls + 1;
+  }
+  sr = StartCritical();
+  dirty = DirtyRows;
+  DirtyRows = 0;
+  EndCritical(sr);
+  for(row=0; dirty; row=row+1){
+    if((dirty&(1<<row)) == 0){
+      continue;
+    }
+    dirty &= ~(1<<row);
+    sr = StartCritical();
+    for(col=0; col<DISPLAYCOLS; col=col+1){
+      text[col] = Want[row][col];
+      color[col] = WantColor[row][col];
+    }
+    EndCritical(sr);
+    col = 0;
+    while(col < DISPLAYCOLS){
+      if(!Differs(row, col, text[col], color[col])){
+        col = col + 1;      // already on the screen
+        continue;
+      }
+      start = col;
+      n = 0;
+      blank = 1;
+      runColor = color[col];
+      while((col < DISPLAYCOLS) && Differs(row, col, text[col], color[col])){
+        if(text[col] != ' '){
+          if(blank){
+            runColor = color[col];
+            blank = 0;
+          } else if(color[col] != runColor){
+            break;
+          }
+        }
+        run[n] = text[col];
+        n = n + 1;
+        col = col + 1;
+      }
+      run[n] = 0;
+      BSP_LCD_DrawString(start, row, run, runColor);
+      DisplayCalls = DisplayCalls + 1;
+      DisplayChars = DisplayChars + n;
+      for(n=start; n<col; n=n+1){
+        Shown[row][n] = text[n];
+        ShownColor[row][n] = runColor;
+      }
+    }
+  }
+  return DisplayCalls - calls;
+}
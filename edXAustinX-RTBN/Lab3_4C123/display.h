@@ -0,0 +1,80 @@
+// display.h
+// Runs on LM4F120/TM4C123/MSP432
+// Batched LCD output for the Lab 3 tasks.  Any thread may write text
+// or queue plot commands, which only touch RAM; one owner thread calls
+// Display_Flush to send them to the LCD in a burst, so no thread holds
+// a mutex while the SPI transfers run.  Text is kept in a character
+// cache, and a flush redraws only the characters that changed.
+
+#ifndef __DISPLAY_H
+#define __DISPLAY_H  1
+
+#include <stdint.h>
+
+#define DISPLAYCOLS 21      // text columns, 0 to 20, as in BSP_LCD_DrawString
+#define DISPLAYROWS 13      // text rows, 0 to 12
+
+extern uint32_t DisplayCalls;      // BSP_LCD calls made by Display_Flush
+extern uint32_t DisplayChars;      // characters sent to the LCD
+extern uint32_t DisplayLostPlots;  // plot commands dropped because the queue was full
+
+// ******** Display_Init ************
+// Forget every queued command; the LCD must be
+// blank, as after BSP_LCD_FillScreen with black
+// Inputs:  none
+// Outputs: none
+void Display_Init(void);
+
+// ******** Display_String ************
+// Write a string into the text cache, clipped at the right edge
+// Inputs:  column (0 to 20), row (0 to 12), string, 16-bit color
+// Outputs: none
+void Display_String(uint32_t col, uint32_t row, const char *pt, uint16_t color);
+
+// ******** Display_UDec4 ************
+// Write a number into the text cache as four characters,
+// right justified, like BSP_LCD_OutUDec4
+// Inputs:  column, row, n (values above 9999 show as 9999), 16-bit color
+// Outputs: none
+void Display_UDec4(uint32_t col, uint32_t row, uint32_t n, uint16_t color);
+
+// ******** Display_UFix2_1 ************
+// Write a fixed-point number into the text cache as four
+// characters dd.d, like BSP_LCD_OutUFix2_1
+// Inputs:  column, row, n in 0.1 units (values above 999 show as 99.9),
+//          16-bit color
+// Outputs: none
+void Display_UFix2_1(uint32_t col, uint32_t row, uint32_t n, uint16_t color);
+
+// ******** Display_Axes ************
+// Queue BSP_LCD_Drawaxes; it erases the plot, so plot
+// commands still queued are dropped, and only the last
+// axes queued before a flush are drawn
+// Inputs:  the parameters of BSP_LCD_Drawaxes, the labels
+//          must stay valid until the next Display_Flush
+// Outputs: none
+void Display_Axes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin);
+
+// ******** Display_PlotPoint ************
+// Queue BSP_LCD_PlotPoint
+// Inputs:  data, 16-bit color
+// Outputs: none
+void Display_PlotPoint(int32_t data, uint16_t color);
+
+// ******** Display_PlotIncrement ************
+// Queue BSP_LCD_PlotIncrement
+// Inputs:  none
+// Outputs: none
+void Display_PlotIncrement(void);
+
+// ******** Display_Flush ************
+// Send the queued axes and plot commands to the LCD, then
+// the characters of the text cache that differ from the screen;
+// only one thread may call it, and no other thread may use the LCD
+// Inputs:  none
+// Outputs: number of BSP_LCD calls made
+uint32_t Display_Flush(void);
+
+#endif
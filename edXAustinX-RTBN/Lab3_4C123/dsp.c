@@ -0,0 +1,129 @@
+// dsp.c
+// Runs on LM4F120/TM4C123/MSP432
+// Fixed-point kernels over blocks of int16_t samples.  The inner loops
+// load two samples as one 32-bit word and use the Cortex M4 dual 16-bit
+// multiply-accumulate instructions, four samples per pass; the last
+// n%4 samples are done one at a time.  Without those instructions
+// (Cortex M3, host builds) PAIR, SMLAD and SMLALD are C that gives
+// the same results, so the loops themselves are the same everywhere.
+
+#include <stdint.h>
+#include <string.h>
+#include "dsp.h"
+
+#define ONES 0x00010001       // 1 in both halves, SMLAD with it adds the two samples
+
+#if (defined(__CC_ARM) && defined(__TARGET_ARCH_7E_M)) || defined(__ARM_FEATURE_DSP)
+// x[0] in the low half, x[1] in the high half.  A uint32_t pointer to
+// int16_t samples would break strict aliasing and claim an alignment
+// x need not have; a 4-byte memcpy is one unaligned LDR on the M4
+static uint32_t PAIR(const int16_t *x){
+  uint32_t pair;
+  memcpy(&pair, x, sizeof(pair));
+  return pair;
+}
+#endif
+
+#if defined(__CC_ARM) && defined(__TARGET_ARCH_7E_M)
+// armcc built-in intrinsics
+#define SMLAD(x, y, acc)     ((int32_t)__smlad((x), (y), (uint32_t)(acc)))
+#define SMLALD(x, y, acc)    ((int64_t)__smlald((x), (y), (uint64_t)(acc)))
+#elif defined(__ARM_FEATURE_DSP)
+// gcc and clang, ARM C Language Extensions
+#include <arm_acle.h>
+#define SMLAD(x, y, acc)     __smlad((x), (y), (acc))
+#define SMLALD(x, y, acc)    __smlald((x), (y), (acc))
+#else
+// x[0] in the low half, x[1] in the high half, as a little-endian load
+#define PAIR(x)              ((uint32_t)(uint16_t)(x)[0] | ((uint32_t)(uint16_t)(x)[1]<<16))
+// acc + low*low + high*high, wrapping at 32 bits as the instruction does
+static int32_t SMLAD(uint32_t x, uint32_t y, int32_t acc){
+  return (int32_t)((uint32_t)acc + (uint32_t)((int16_t)x*(int16_t)y)
+                                 + (uint32_t)((int16_t)(x>>16)*(int16_t)(y>>16)));
+}
+// acc + low*low + high*high, with a 64-bit accumulator
+static int64_t SMLALD(uint32_t x, uint32_t y, int64_t acc){
+  return acc + (int16_t)x*(int16_t)y + (int16_t)(x>>16)*(int16_t)(y>>16);
+}
+#endif
+
+// ******** DSP_Sum ************
+// Sum of a block of samples, SMLAD against 1 in both halves
+// Inputs:  samples, number of samples (at most 65536)
+// Outputs: sum
+int32_t DSP_Sum(const int16_t *x, uint32_t n){
+  int32_t sum = 0;
+  while(n >= 4){
+    sum = SMLAD(PAIR(x), ONES, sum);
+    sum = SMLAD(PAIR(x+2), ONES, sum);
+    x = x + 4;
+    n = n - 4;
+  }
+  while(n){
+    sum = sum + *x;
+    x = x + 1;
+    n = n - 1;
+  }
+  return sum;
+}
+
+// ******** DSP_SumSquares ************
+// Sum of the squares of a block of samples, SMLALD of each pair with itself
+// Inputs:  samples, number of samples
+// Outputs: sum of squares
+int64_t DSP_SumSquares(const int16_t *x, uint32_t n){
+  int64_t sum = 0;
+  uint32_t pair;
+  while(n >= 4){
+    pair = PAIR(x);
+    sum = SMLALD(pair, pair, sum);
+    pair = PAIR(x+2);
+    sum = SMLALD(pair, pair, sum);
+    x = x + 4;
+    n = n - 4;
+  }
+  while(n){
+    sum = sum + (*x)*(*x);
+    x = x + 1;
+    n = n - 1;
+  }
+  return sum;
+}
+
+// ******** DSP_Dot ************
+// Dot product of two blocks of samples, SMLALD of matching pairs
+// Inputs:  two blocks of samples, number of samples in each
+// Outputs: sum of x[i]*y[i]
+int64_t DSP_Dot(const int16_t *x, const int16_t *y, uint32_t n){
+  int64_t sum = 0;
+  while(n >= 4){
+    sum = SMLALD(PAIR(x), PAIR(y), sum);
+    sum = SMLALD(PAIR(x+2), PAIR(y+2), sum);
+    x = x + 4;
+    y = y + 4;
+    n = n - 4;
+  }
+  while(n){
+    sum = sum + (*x)*(*y);
+    x = x + 1;
+    y = y + 1;
+    n = n - 1;
+  }
+  return sum;
+}
+
+// ******** DSP_Decimate ************
+// Each output is DSP_Sum of factor inputs divided by factor;
+// output k is stored after inputs k*factor on are read,
+// so in and out may be the same block
+// Inputs:  samples, number of samples, factor (1 to 65536),
+//          where to store n/factor outputs
+// Outputs: number of outputs stored
+uint32_t DSP_Decimate(const int16_t *in, uint32_t n, uint32_t factor, int16_t *out){
+  uint32_t k, count = n/factor;
+  for(k=0; k<count; k=k+1){
+    out[k] = (int16_t)(DSP_Sum(in, factor)/(int32_t)factor);
+    in = in + factor;
+  }
+  return count;
+}
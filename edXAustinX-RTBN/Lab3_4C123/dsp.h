@@ -0,0 +1,39 @@
+// dsp.h
+// Runs on LM4F120/TM4C123/MSP432
+// Fixed-point kernels over blocks of int16_t samples.  On a Cortex M4
+// each instruction of the inner loops multiplies and adds two samples
+// at once (SMLAD, SMLALD); elsewhere the same loops run in plain C.
+
+#ifndef __DSP_H
+#define __DSP_H  1
+
+#include <stdint.h>
+
+// ******** DSP_Sum ************
+// Sum of a block of samples
+// Inputs:  samples, number of samples (at most 65536)
+// Outputs: sum
+int32_t DSP_Sum(const int16_t *x, uint32_t n);
+
+// ******** DSP_SumSquares ************
+// Sum of the squares of a block of samples
+// Inputs:  samples, number of samples
+// Outputs: sum of squares
+int64_t DSP_SumSquares(const int16_t *x, uint32_t n);
+
+// ******** DSP_Dot ************
+// Dot product of two blocks of samples
+// Inputs:  two blocks of samples, number of samples in each
+// Outputs: sum of x[i]*y[i]
+int64_t DSP_Dot(const int16_t *x, const int16_t *y, uint32_t n);
+
+// ******** DSP_Decimate ************
+// Reduce the sample rate by a factor, each output being
+// the mean of factor inputs (a boxcar anti-alias filter)
+// in and out may be the same block
+// Inputs:  samples, number of samples, factor (1 to 65536),
+//          where to store n/factor outputs
+// Outputs: number of outputs stored
+uint32_t DSP_Decimate(const int16_t *in, uint32_t n, uint32_t factor, int16_t *out);
+
+#endif
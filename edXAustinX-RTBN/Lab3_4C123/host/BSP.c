@@ -0,0 +1,150 @@
+// BSP.c
+// Runs on Linux/POSIX
+// Host Board Support Package for the Lab 3 RTOS.  Enough of the
+// real BSP to run os.c and the Lab3.c test programs: the periodic
+// task runs from a POSIX timer, sensors produce synthetic data,
+// and the display/LED/buzzer/buttons are inert.  Also provides
+// do-nothing stand-ins for the TExaS grader (texas.o).
+
+#include <stdint.h>
+#include "BSP.h"
+#include "Host.h"
+#include "Texas.h"
+
+static void (*PeriodicTask)(void);
+static timer_t PeriodicTimer;
+static int PeriodicTimerMade;
+static uint64_t TimeZeroNs;
+static uint64_t LoopsPerMs;    // BSP_Delay1ms calibration
+
+//------------ buttons, LED, buzzer ------------
+void BSP_Button1_Init(void){}
+uint8_t BSP_Button1_Input(void){ return 1; } // 1 means not pressed
+void BSP_Button2_Init(void){}
+uint8_t BSP_Button2_Input(void){ return 1; }
+void BSP_RGB_Init(int16_t red, int16_t green, int16_t blue){}
+void BSP_RGB_Set(int16_t red, int16_t green, int16_t blue){}
+void BSP_Buzzer_Init(uint16_t duty){}
+void BSP_Buzzer_Set(uint16_t duty){}
+
+//------------ sensors ------------
+static uint32_t Seed = 1;
+static uint32_t Noise(uint32_t range){ // tiny LCG, deterministic across runs
+  Seed = Seed*1664525 + 1013904223;
+  return (Seed>>16)%range;
+}
+void BSP_Accelerometer_Init(void){}
+// one stride every 2 sec when sampled at 10 Hz
+void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z){
+  static uint32_t n;
+  static const int16_t stride[20] = {0, 40, 80, 120, 160, 200, 160, 120, 80, 40,
+                                     0, -40, -80, -120, -160, -200, -160, -120, -80, -40};
+  n = n + 1;
+  *x = 512 + Noise(8);
+  *y = 512 + Noise(8);
+  *z = 700 + stride[n%20] + Noise(8);
+}
+void BSP_Microphone_Init(void){}
+void BSP_Microphone_Input(uint16_t *mic){
+  *mic = 600 + Noise(64);
+}
+static uint64_t LightDoneNs, TempDoneNs;
+void BSP_LightSensor_Init(void){}
+void BSP_LightSensor_Start(void){
+  LightDoneNs = Host_TimeNs() + 100000000; // OPT3001 needs 100 ms
+}
+int BSP_LightSensor_End(uint32_t *light){
+  if(Host_TimeNs() < LightDoneNs) return 0;
+  *light = 40000 + Noise(1000);
+  return 1;
+}
+void BSP_TempSensor_Init(void){}
+void BSP_TempSensor_Start(void){
+  TempDoneNs = Host_TimeNs() + 250000000;  // TMP006 needs 250 ms
+}
+int BSP_TempSensor_End(int32_t *sensorV, int32_t *localT){
+  if(Host_TimeNs() < TempDoneNs) return 0;
+  *sensorV = 0;
+  *localT = 2350000 + Noise(10000);
+  return 1;
+}
+
+//------------ clock, time and delay ------------
+void BSP_Clock_InitFastest(void){
+  volatile uint64_t i;
+  uint64_t start, loops = 1000000;
+  if(LoopsPerMs) return;
+  start = Host_TimeNs();
+  for(i=0; i<loops; i=i+1){}
+  LoopsPerMs = loops*1000000/(Host_TimeNs() - start + 1) + 1;
+}
+uint32_t BSP_Clock_GetFreq(void){
+  return HOST_CLOCK_FREQ;
+}
+void BSP_Time_Init(void){
+  TimeZeroNs = Host_TimeNs();
+}
+uint32_t BSP_Time_Get(void){
+  return (uint32_t)((Host_TimeNs() - TimeZeroNs)/1000);
+}
+void BSP_Delay1ms(uint32_t n){
+  volatile uint64_t i;
+  BSP_Clock_InitFastest();
+  for(i=0; i<n*LoopsPerMs; i=i+1){}
+}
+
+//------------ periodic task ------------
+static void Periodic_Handler(int sig){
+  Host_IsrNesting++;
+  Host_Stats.periodic++;
+  PeriodicTask();
+  Host_IsrNesting--;
+}
+void BSP_PeriodicTask_Init(void(*task)(void), uint32_t freq, uint8_t priority){
+  PeriodicTask = task;
+  Host_InstallIsr(HOST_SIG_PERIODIC, &Periodic_Handler);
+  if(!PeriodicTimerMade){
+    PeriodicTimer = Host_TimerCreate(HOST_SIG_PERIODIC);
+    PeriodicTimerMade = 1;
+  }
+  Host_TimerArm(PeriodicTimer, 1000000000u/freq);
+}
+void BSP_PeriodicTask_Stop(void){
+  if(PeriodicTimerMade){
+    Host_TimerArm(PeriodicTimer, 0);
+  }
+}
+
+//------------ LCD ------------
+void BSP_LCD_Init(void){}
+uint16_t BSP_LCD_Color565(uint8_t r, uint8_t g, uint8_t b){
+  return ((r&0xF8)<<8) | ((g&0xFC)<<3) | (b>>3);
+}
+void BSP_LCD_FillScreen(uint16_t color){}
+void BSP_LCD_DrawBitmap(int16_t x, int16_t y, const uint16_t *image, int16_t w, int16_t h){}
+uint32_t BSP_LCD_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor){
+  uint32_t n = 0;
+  while(pt[n]) n = n + 1;
+  return n;
+}
+void BSP_LCD_SetCursor(uint32_t newX, uint32_t newY){}
+void BSP_LCD_OutUDec4(uint32_t n, int16_t textColor){}
+void BSP_LCD_OutUFix2_1(uint32_t n, int16_t textColor){}
+void BSP_LCD_Drawaxes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin){}
+void BSP_LCD_PlotPoint(int32_t data1, uint16_t color1){}
+void BSP_LCD_PlotIncrement(void){}
+
+//------------ TExaS grader ------------
+// The grader only records task start times; kept out of line so the
+// busy loops in the Lab3.c test threads still store their counters.
+void TExaS_Init(enum TExaSmode mode, uint32_t edXcode){}
+void TExaS_Stop(void){}
+void TExaS_Task0(void){}
+void TExaS_Task1(void){}
+void TExaS_Task2(void){}
+void TExaS_Task3(void){}
+void TExaS_Task4(void){}
+void TExaS_Task5(void){}
+void TExaS_Task6(void){}
@@ -0,0 +1,135 @@
+// CortexM.c
+// Runs on Linux/POSIX
+// Host model of PRIMASK, the SysTick registers used by os.c, and
+// the timers that raise the simulated interrupts.
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "CortexM.h"
+#include "Host.h"
+
+volatile uint32_t Host_STCTRL;
+volatile uint32_t Host_STRELOAD;
+volatile uint32_t Host_SYSPRI3;
+volatile int Host_IsrNesting;
+static volatile uint32_t STCurrent; // reads as 0, writes are ignored
+static volatile uint32_t IntCtrl;
+volatile uint32_t Host_DEMCR;
+volatile uint32_t Host_DWT_CTRL;
+static volatile uint32_t CycCnt;
+static timer_t SysTickTimer;
+static int SysTickTimerMade;
+
+uint64_t Host_TimeNs(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void Host_IrqSet(sigset_t *set){
+  sigemptyset(set);
+  sigaddset(set, HOST_SIG_SYSTICK);
+  sigaddset(set, HOST_SIG_PERIODIC);
+  sigaddset(set, HOST_SIG_PENDSV);
+  sigaddset(set, HOST_SIG_EXTERNAL);
+}
+
+void Host_InstallIsr(int sig, void(*handler)(int)){
+  struct sigaction sa;
+  sa.sa_handler = handler;
+  Host_IrqSet(&sa.sa_mask);     // handlers run with PRIMASK set
+  sa.sa_flags = SA_RESTART;
+  if(sigaction(sig, &sa, 0)){
+    perror("sigaction");
+    exit(1);
+  }
+}
+
+timer_t Host_TimerCreate(int sig){
+  struct sigevent sev = {0};
+  timer_t timer;
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = sig;
+  if(timer_create(CLOCK_MONOTONIC, &sev, &timer)){
+    perror("timer_create");
+    exit(1);
+  }
+  return timer;
+}
+
+void Host_TimerArm(timer_t timer, uint64_t periodNs){
+  struct itimerspec its;
+  its.it_interval.tv_sec = periodNs/1000000000u;
+  its.it_interval.tv_nsec = periodNs%1000000000u;
+  its.it_value = its.it_interval;
+  timer_settime(timer, 0, &its, 0);
+}
+
+void Host_SysTickRestart(void){
+  uint64_t period = 0;
+  if(!SysTickTimerMade){
+    SysTickTimer = Host_TimerCreate(HOST_SIG_SYSTICK);
+    SysTickTimerMade = 1;
+  }
+  if((Host_STCTRL&0x03) == 0x03){ // enabled and interrupt armed
+    period = ((uint64_t)Host_STRELOAD + 1)*1000000000u/HOST_CLOCK_FREQ;
+  }
+  Host_TimerArm(SysTickTimer, period);
+}
+
+// Inside a simulated ISR PRIMASK is already set by the handler mask
+// and must stay set: on the real core a higher priority ISR cannot
+// be preempted by SysTick even after it executes CPSIE I.
+void DisableInterrupts(void){
+  sigset_t irq;
+  if(Host_IsrNesting) return;
+  Host_IrqSet(&irq);
+  sigprocmask(SIG_BLOCK, &irq, 0);
+}
+
+void EnableInterrupts(void){
+  sigset_t irq;
+  if(Host_IsrNesting) return;
+  Host_IrqSet(&irq);
+  sigprocmask(SIG_UNBLOCK, &irq, 0);
+}
+
+long StartCritical(void){
+  sigset_t irq, old;
+  if(Host_IsrNesting) return 1;
+  Host_IrqSet(&irq);
+  sigprocmask(SIG_BLOCK, &irq, &old);
+  return sigismember(&old, HOST_SIG_SYSTICK);
+}
+
+void EndCritical(long sr){
+  if(!sr){
+    EnableInterrupts();
+  }
+}
+
+void WaitForInterrupt(void){
+  sigset_t now;
+  sigprocmask(SIG_BLOCK, 0, &now);
+  sigsuspend(&now);
+}
+
+volatile uint32_t *Host_STCURRENT(void){
+  if(SysTickTimerMade){
+    Host_SysTickRestart();
+  }
+  return &STCurrent;
+}
+
+volatile uint32_t *Host_DWT_CYCCNT(void){
+  CycCnt = (uint32_t)(Host_TimeNs()*(HOST_CLOCK_FREQ/1000000)/1000);
+  return &CycCnt;
+}
+
+volatile uint32_t *Host_INTCTRL(void){
+  raise(HOST_SIG_PENDSV);   // taken now, or once unmasked: after the ISR or EnableInterrupts
+  return &IntCtrl;
+}
@@ -0,0 +1,75 @@
+// Host.h
+// Runs on Linux/POSIX
+// Private glue shared by the host versions of CortexM.c, BSP.c,
+// osasm.c, the Lab3host.c runner and the ostest.c kernel tests.
+// Not included by os.c or Lab3.c.
+// Three POSIX signals stand in for the three interrupts the Lab 3
+// kernel uses, a fourth for an interrupt from outside the kernel,
+// and blocking those signals stands in for PRIMASK.
+
+#ifndef __HOST_H
+#define __HOST_H  1
+
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+
+#define HOST_SIG_SYSTICK  SIGALRM  // plays the role of the SysTick exception
+#define HOST_SIG_PERIODIC SIGUSR1  // plays the role of the BSP periodic timer interrupt
+#define HOST_SIG_PENDSV   SIGUSR2  // plays the role of PendSV, raised by writing INTCTRL
+#define HOST_SIG_EXTERNAL SIGURG   // plays the role of any other interrupt, e.g. a GPIO edge in a test
+#define HOST_CLOCK_FREQ   80000000 // simulated bus clock, same as BSP_Clock_InitFastest on TM4C123
+
+// number of simulated interrupt handlers currently active (0 means thread mode)
+extern volatile int Host_IsrNesting;
+
+// ******** Host_TimeNs ************
+// Monotonic host time
+// Inputs:  none
+// Outputs: nanoseconds since an arbitrary epoch
+uint64_t Host_TimeNs(void);
+
+// ******** Host_IrqSet ************
+// Set of signals that model maskable interrupts
+// Inputs:  pointer to signal set to fill
+// Outputs: none
+void Host_IrqSet(sigset_t *set);
+
+// ******** Host_InstallIsr ************
+// Install a simulated interrupt handler; every simulated
+// interrupt masks all others while it runs (like CPSID I)
+// Inputs:  signal number, handler
+// Outputs: none
+void Host_InstallIsr(int sig, void(*handler)(int));
+
+// ******** Host_TimerCreate ************
+// Create a disarmed timer that raises sig on expiry
+// Inputs:  signal number
+// Outputs: timer handle
+timer_t Host_TimerCreate(int sig);
+
+// ******** Host_TimerArm ************
+// Arm a periodic timer, restarting the current period
+// Inputs:  timer handle, period in nsec (0 disarms the timer)
+// Outputs: none
+void Host_TimerArm(timer_t timer, uint64_t periodNs);
+
+// ******** Host_SysTickRestart ************
+// Reprogram the SysTick timer from STCTRL/STRELOAD, as a write to
+// STCURRENT does on the real core
+// Inputs:  none
+// Outputs: none
+void Host_SysTickRestart(void);
+
+// context switch statistics collected by the host SysTick and PendSV handlers
+struct HostStats{
+  uint64_t ticks;        // SysTick interrupts
+  uint64_t switches;     // PendSVs that resumed a different thread
+  uint64_t switchMinNs;  // fastest PendSV entry to new thread running
+  uint64_t switchMaxNs;  // slowest PendSV entry to new thread running
+  uint64_t switchSumNs;  // for the average
+  uint64_t periodic;     // periodic timer interrupts
+};
+extern struct HostStats Host_Stats;
+
+#endif
@@ -0,0 +1,260 @@
+// Lab3host.c
+// Runs on Linux/POSIX
+// Runner for the host port of the Lab 3 RTOS.  Starts one of the
+// unmodified Lab3.c test programs, lets it run for a while, then
+// prints the program's own counters together with the context
+// switch cost measured by the host SysTick handler.
+//   lab3host step1|step2|step3|step4|step5|main|bench [seconds [tracefile]]
+//   lab3host mutex|fifo|pool|defer|tickless|sleep|ring|trace|mailbox|edf|event|i2c [seconds]
+// The second form runs a kernel test from ostest.c and exits with
+// status 1 if it failed.  The static test needs lab3static, the
+// same program with os.c built from the tables in osstatic.h.
+// With a tracefile the kernel trace ring is saved there at the end,
+// in the same layout as a debugger dump; see tracedecode.c.
+// Times are host nanoseconds, not TM4C123 bus cycles: use them to
+// compare kernel versions on the same machine.
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Host.h"
+#include "os.h"
+#include "display.h"
+
+// Lab3.c is built with -Dmain=Lab3_main
+int Lab3_main(void);
+int main_step1(void);
+int main_step2(void);
+int main_step3(void);
+int main_step4(void);
+int main_step5(void);
+int main_bench(void);
+int main_mutex(void);   // ostest.c
+int main_fifo(void);
+int main_pool(void);
+int main_defer(void);
+int main_tickless(void);
+int main_sleep(void);
+int main_ring(void);
+int main_trace(void);
+int main_mailbox(void);
+int main_edf(void);
+int main_event(void);
+int main_i2c(void);
+int main_static(void);
+
+extern int32_t s1, s2;
+extern int32_t CountA, CountB, CountC, CountD, CountE, CountF;
+extern int32_t TaskGdata, TaskHLostData, CountI, CountJ, CountK, CountL;
+extern int32_t TaskMdata, TaskNLostData, CountO, CountP, CountQ, CountR;
+extern int32_t TaskSdata, TaskTLostData, CountU, CountV, CountW, CountX, CountY, CountZ;
+extern uint32_t Time, Steps, SoundRMS, LightData, LostTask1Data, Count7;
+extern uint32_t Task2Id, Task5Id;
+extern int32_t TemperatureData;
+
+struct histogram{             // as in Lab3.c
+  uint32_t Count;
+  uint32_t Min;
+  uint32_t Max;
+  uint64_t Sum;
+  uint32_t Bin[16];
+};
+extern struct histogram SwitchHist, PingHist, FifoHist, WakeHist, JitterHist, StatsHist, BlockHist;
+extern int32_t BenchDone, BenchStatsErrors;
+extern int32_t TestDone, TestErrors;
+extern uint32_t TestFailLine[];
+
+static double Seconds = 2.0;
+static const char *TraceFile;
+static int ExitStatus;        // 1 once a test has failed
+
+static void Rate(const char *name, int64_t count){
+  printf("  %-14s %10lld  %10.1f/s\n", name, (long long)count, count/Seconds);
+}
+
+static void ReportStep1(void){
+  printf("  s1=%ld s2=%ld\n", (long)s1, (long)s2);
+}
+static void ReportStep2(void){ // semaphore signal/wait pairs
+  Rate("CountA", CountA); Rate("CountB", CountB);
+  Rate("CountC", CountC); Rate("CountD", CountD);
+  Rate("CountE", CountE); Rate("CountF", CountF);
+}
+static void ReportStep3(void){ // FIFO throughput under round robin
+  Rate("FIFO puts", TaskGdata); Rate("TaskHLostData", TaskHLostData);
+  Rate("CountI", CountI); Rate("CountJ", CountJ);
+  Rate("CountK", CountK); Rate("CountL", CountL);
+}
+static void ReportStep4(void){ // sleeping
+  Rate("FIFO puts", TaskMdata); Rate("TaskNLostData", TaskNLostData);
+  Rate("CountO", CountO); Rate("CountP", CountP);
+  Rate("CountQ", CountQ); Rate("CountR", CountR);
+}
+static void ReportStep5(void){ // periodic event threads
+  Rate("FIFO puts", TaskSdata); Rate("TaskTLostData", TaskTLostData);
+  Rate("CountU", CountU); Rate("CountV", CountV);
+  Rate("CountW", CountW); Rate("CountX", CountX);
+  Rate("CountY", CountY); Rate("CountZ", CountZ);
+}
+static void ReportMain(void){  // fitness device
+  printf("  Time=%lu Steps=%lu SoundRMS=%lu Light=%lu Temp=%ld\n",
+    (unsigned long)Time, (unsigned long)Steps, (unsigned long)SoundRMS,
+    (unsigned long)LightData, (long)TemperatureData);
+  Rate("LostTask1Data", LostTask1Data); Rate("Count7", Count7);
+  Rate("Task2 misses", OS_DeadlineMisses(Task2Id)); Rate("Task5 misses", OS_DeadlineMisses(Task5Id));
+  Rate("LCD calls", DisplayCalls); Rate("LCD chars", DisplayChars);
+  Rate("LostPlotData", DisplayLostPlots);
+}
+
+static void Histogram(const char *name, const struct histogram *h){
+  int i, last = 0;
+  if(h->Count == 0){
+    printf("  %-8s no samples\n", name);
+    return;
+  }
+  printf("  %-8s %8lu samples  cycles min %lu  avg %lu  max %lu\n", name,
+    (unsigned long)h->Count, (unsigned long)h->Min,
+    (unsigned long)(h->Sum/h->Count), (unsigned long)h->Max);
+  for(i=0; i<16; i=i+1){
+    if(h->Bin[i]) last = i;
+  }
+  for(i=0; i<=last; i=i+1){
+    if(h->Bin[i] && (i == 15)){
+      printf("    %6lu+       %8lu\n", 1ul<<i, (unsigned long)h->Bin[i]);
+    } else if(h->Bin[i]){
+      printf("    %6lu-%-6lu %8lu\n", (i == 0) ? 0ul : (1ul<<i), (2ul<<i)-1, (unsigned long)h->Bin[i]);
+    }
+  }
+}
+static void ReportBench(void){ // kernel benchmark, in HOST_CLOCK_FREQ cycles
+  if(!BenchDone){
+    printf("  not finished, run for at least 1.1 s\n");
+  }
+  Histogram("switch", &SwitchHist);
+  Histogram("pingpong", &PingHist);
+  Histogram("fifo", &FifoHist);
+  Histogram("wakeup", &WakeHist);
+  Histogram("jitter", &JitterHist);
+  Histogram("stats", &StatsHist);
+  Histogram("block", &BlockHist);
+  Rate("stats errors", BenchStatsErrors);
+}
+
+static void ReportTest(void){ // kernel test from ostest.c
+  int32_t i;
+  if(!TestDone){
+    printf("  not finished\n");
+    ExitStatus = 1;
+  }
+  for(i=0; (i < TestErrors) && (i < 8); i=i+1){ // 8 is MAXFAILS in ostest.c
+    printf("  check failed at ostest.c:%lu\n", (unsigned long)TestFailLine[i]);
+  }
+  if(TestErrors){
+    ExitStatus = 1;
+  }
+  Rate("test errors", TestErrors);
+}
+
+struct Program{
+  const char *name;
+  int (*run)(void);
+  void (*report)(void);
+};
+static const struct Program Programs[] = {
+  {"step1", &main_step1, &ReportStep1},
+  {"step2", &main_step2, &ReportStep2},
+  {"step3", &main_step3, &ReportStep3},
+  {"step4", &main_step4, &ReportStep4},
+  {"step5", &main_step5, &ReportStep5},
+  {"main",  &Lab3_main,  &ReportMain},
+  {"bench", &main_bench, &ReportBench},
+  {"mutex", &main_mutex, &ReportTest},
+  {"fifo",  &main_fifo,  &ReportTest},
+  {"pool",  &main_pool,  &ReportTest},
+  {"defer", &main_defer, &ReportTest},
+  {"tickless", &main_tickless, &ReportTest},
+  {"sleep", &main_sleep, &ReportTest},
+  {"ring", &main_ring, &ReportTest},
+  {"trace", &main_trace, &ReportTest},
+  {"mailbox", &main_mailbox, &ReportTest},
+  {"edf", &main_edf, &ReportTest},
+  {"event", &main_event, &ReportTest},
+  {"i2c", &main_i2c, &ReportTest},
+  {"static", &main_static, &ReportTest},
+};
+static const struct Program *Selected;
+
+// header followed by Size records, as laid out in os.c
+static void SaveTrace(void){
+  const struct TraceHeader *trace = OS_Trace();
+  FILE *f;
+  if(trace == 0){
+    fprintf(stderr, "lab3host: os.c was built without TRACE\n");
+    return;
+  }
+  f = fopen(TraceFile, "wb");
+  if(f == 0){
+    perror(TraceFile);
+    return;
+  }
+  fwrite(trace, sizeof(*trace) + trace->Size*sizeof(struct TraceRecord), 1, f);
+  fclose(f);
+}
+
+// runs as a real pthread with every signal blocked, so it never
+// takes a simulated interrupt and is invisible to the scheduler
+static void *Watchdog(void *arg){
+  struct timespec ts;
+  uint64_t switches;
+  ts.tv_sec = (time_t)Seconds;
+  ts.tv_nsec = (long)((Seconds - ts.tv_sec)*1e9);
+  while(nanosleep(&ts, &ts)){}
+  switches = Host_Stats.switches;
+  if(TraceFile){
+    SaveTrace();                   // the OS keeps running, a record may be torn
+  }
+  printf("%s: %.1f s\n", Selected->name, Seconds);
+  Selected->report();
+  printf("  SysTick        %10llu  %10.1f/s\n", (unsigned long long)Host_Stats.ticks, Host_Stats.ticks/Seconds);
+  printf("  periodic       %10llu  %10.1f/s\n", (unsigned long long)Host_Stats.periodic, Host_Stats.periodic/Seconds);
+  printf("  switches       %10llu  %10.1f/s\n", (unsigned long long)switches, switches/Seconds);
+  if(switches){
+    printf("  switch ns      min %llu  avg %llu  max %llu\n",
+      (unsigned long long)Host_Stats.switchMinNs,
+      (unsigned long long)(Host_Stats.switchSumNs/switches),
+      (unsigned long long)Host_Stats.switchMaxNs);
+  }
+  fflush(stdout);
+  _exit(ExitStatus);
+  return 0;
+}
+
+int main(int argc, char **argv){
+  const char *name = (argc > 1) ? argv[1] : "main";
+  sigset_t all, old;
+  pthread_t tid;
+  int i;
+  for(i=0; i<(int)(sizeof(Programs)/sizeof(Programs[0])); i=i+1){
+    if(strcmp(name, Programs[i].name) == 0){
+      Selected = &Programs[i];
+    }
+  }
+  if((Selected == 0) || ((argc > 2) && ((Seconds = atof(argv[2])) <= 0))){
+    fprintf(stderr, "usage: %s step1|step2|step3|step4|step5|main|bench|mutex|fifo|pool|defer|tickless|sleep|ring|trace|mailbox|edf|event|i2c|static [seconds [tracefile]]\n", argv[0]);
+    return 2;
+  }
+  if(argc > 3){
+    TraceFile = argv[3];
+  }
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK, &all, &old);
+  pthread_create(&tid, 0, &Watchdog, 0);
+  pthread_sigmask(SIG_SETMASK, &old, 0);
+  Selected->run();                 // does not return
+  return 1;
+}
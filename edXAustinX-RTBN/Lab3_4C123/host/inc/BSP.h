@@ -0,0 +1,84 @@
+// BSP.h
+// Runs on Linux/POSIX
+// Host replacement for ../inc/BSP.h covering the Board Support
+// Package functions used by os.c and Lab3.c.  Sensors return
+// synthetic data, the LCD, LED, buzzer and buttons do nothing, and
+// the periodic task runs from a POSIX timer.
+
+#ifndef __BSP_H
+#define __BSP_H  1
+
+#include <stdint.h>
+
+// standard 16-bit 565 colors
+#define LCD_BLACK      0x0000
+#define LCD_BLUE       0x001F
+#define LCD_DARKBLUE   0x34BF
+#define LCD_RED        0xF800
+#define LCD_GREEN      0x07E0
+#define LCD_LIGHTGREEN 0x07EF
+#define LCD_ORANGE     0xFD60
+#define LCD_CYAN       0x07FF
+#define LCD_MAGENTA    0xF81F
+#define LCD_YELLOW     0xFFE0
+#define LCD_WHITE      0xFFFF
+#define LCD_GREY       0x8410
+
+void BSP_Button1_Init(void);
+uint8_t BSP_Button1_Input(void);
+void BSP_Button2_Init(void);
+uint8_t BSP_Button2_Input(void);
+
+void BSP_RGB_Init(int16_t red, int16_t green, int16_t blue);
+void BSP_RGB_Set(int16_t red, int16_t green, int16_t blue);
+void BSP_Buzzer_Init(uint16_t duty);
+void BSP_Buzzer_Set(uint16_t duty);
+
+void BSP_Accelerometer_Init(void);
+void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z);
+void BSP_Microphone_Init(void);
+void BSP_Microphone_Input(uint16_t *mic);
+void BSP_LightSensor_Init(void);
+void BSP_LightSensor_Start(void);
+int BSP_LightSensor_End(uint32_t *light);
+void BSP_TempSensor_Init(void);
+void BSP_TempSensor_Start(void);
+int BSP_TempSensor_End(int32_t *sensorV, int32_t *localT);
+
+void BSP_Clock_InitFastest(void);
+uint32_t BSP_Clock_GetFreq(void);
+
+// ------------BSP_PeriodicTask_Init------------
+// Activate a periodic interrupt that runs a user task
+// Inputs:  task is a pointer to a user function
+//          freq is number of interrupts per second
+//          priority is ignored on the host: the periodic task
+//          always preempts threads and never nests with SysTick
+// Outputs: none
+void BSP_PeriodicTask_Init(void(*task)(void), uint32_t freq, uint8_t priority);
+void BSP_PeriodicTask_Stop(void);
+
+void BSP_Time_Init(void);
+// ------------BSP_Time_Get------------
+// Outputs: system time in usec since BSP_Time_Init
+uint32_t BSP_Time_Get(void);
+// ------------BSP_Delay1ms------------
+// Busy-wait n msec of CPU time, so like the real delay it is
+// stretched by every other thread that gets a time slice
+void BSP_Delay1ms(uint32_t n);
+
+void BSP_LCD_Init(void);
+uint16_t BSP_LCD_Color565(uint8_t r, uint8_t g, uint8_t b);
+void BSP_LCD_FillScreen(uint16_t color);
+void BSP_LCD_DrawBitmap(int16_t x, int16_t y, const uint16_t *image, int16_t w, int16_t h);
+uint32_t BSP_LCD_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor);
+void BSP_LCD_SetCursor(uint32_t newX, uint32_t newY);
+void BSP_LCD_OutUDec4(uint32_t n, int16_t textColor);
+void BSP_LCD_OutUFix2_1(uint32_t n, int16_t textColor);
+void BSP_LCD_Drawaxes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin);
+void BSP_LCD_PlotPoint(int32_t data1, uint16_t color1);
+void BSP_LCD_PlotIncrement(void);
+
+#endif
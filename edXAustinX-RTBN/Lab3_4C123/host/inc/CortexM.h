@@ -0,0 +1,52 @@
+// CortexM.h
+// Runs on Linux/POSIX
+// Host replacement for ../inc/CortexM.h used by the host port of
+// the Lab 3 RTOS.  Interrupt masking is modelled by blocking the
+// signals that stand in for SysTick and the periodic timer, and the
+// handful of core registers os.c touches are plain variables.
+
+#ifndef __CORTEXM_H
+#define __CORTEXM_H  1
+
+#include <stdint.h>
+
+// ******** DisableInterrupts ************
+// Set PRIMASK: block every simulated interrupt
+void DisableInterrupts(void);
+
+// ******** EnableInterrupts ************
+// Clear PRIMASK: allow simulated interrupts
+void EnableInterrupts(void);
+
+// ******** StartCritical ************
+// Save PRIMASK and disable interrupts
+// Outputs: previous PRIMASK (1 means interrupts were disabled)
+long StartCritical(void);
+
+// ******** EndCritical ************
+// Restore PRIMASK saved by StartCritical
+void EndCritical(long sr);
+
+// ******** WaitForInterrupt ************
+// Sleep until the next simulated interrupt
+void WaitForInterrupt(void);
+
+extern volatile uint32_t Host_STCTRL;
+extern volatile uint32_t Host_STRELOAD;
+extern volatile uint32_t Host_SYSPRI3;
+volatile uint32_t *Host_STCURRENT(void);
+volatile uint32_t *Host_INTCTRL(void);
+extern volatile uint32_t Host_DEMCR;
+extern volatile uint32_t Host_DWT_CTRL;
+volatile uint32_t *Host_DWT_CYCCNT(void);
+
+#define STCTRL    Host_STCTRL
+#define STRELOAD  Host_STRELOAD
+#define SYSPRI3   Host_SYSPRI3
+#define STCURRENT (*Host_STCURRENT()) // any write clears it: restarts the time slice
+#define INTCTRL   (*Host_INTCTRL())   // any write pends PendSV (the only use in os.c)
+#define DEMCR     Host_DEMCR
+#define DWT_CTRL  Host_DWT_CTRL
+#define DWT_CYCCNT (*Host_DWT_CYCCNT()) // reads host time in HOST_CLOCK_FREQ cycles, writes are ignored
+
+#endif
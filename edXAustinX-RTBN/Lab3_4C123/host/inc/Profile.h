@@ -0,0 +1,18 @@
+// Profile.h
+// Runs on Linux/POSIX
+// Host replacement for ../inc/Profile.h.  There are no profiling
+// pins on the host, so every toggle compiles to nothing.
+
+#ifndef __PROFILE_H
+#define __PROFILE_H  1
+
+#define Profile_Init()
+#define Profile_Toggle0()
+#define Profile_Toggle1()
+#define Profile_Toggle2()
+#define Profile_Toggle3()
+#define Profile_Toggle4()
+#define Profile_Toggle5()
+#define Profile_Toggle6()
+
+#endif
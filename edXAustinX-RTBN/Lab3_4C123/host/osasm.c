@@ -0,0 +1,133 @@
+// osasm.c
+// Runs on Linux/POSIX
+// Host replacement for osasm.s: StartOS and PendSV_Handler for the
+// host port of the Lab 3 RTOS, using ucontext instead of R4-R11 and
+// an exception frame.  Also routes the SysTick signal to os.c.
+//
+// Like osasm.s this file only knows that the first field of a TCB
+// is its saved stack pointer.  A thread that has never run still has
+// the fake exception frame built by SetInitialStack, and its entry
+// point is read from the PC slot of that frame.  Threads run on host
+// stacks, because the StackPool blocks are far too small for host
+// code; the first time a TCB is switched to, its sp is replaced by a
+// pointer to its host context.
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include "Host.h"
+
+#define MAXHOSTTHREADS 32         // TCBs that can ever be switched to
+#define HOSTSTACKSIZE  (64*1024)  // bytes of host stack per thread
+#define HOSTMAGIC      0x484F5354 // "HOST", never the padding word of a fresh frame
+
+struct tcb;                       // layout private to os.c
+extern struct tcb *RunPt;         // currently running thread
+void Scheduler(void);
+void SysTick_Handler(void);
+
+struct HostThread{
+  uint32_t magic;                 // HOSTMAGIC, sits where the frame's padding would be
+  struct tcb *tcb;                // owning TCB
+  void (*entry)(void);            // thread function
+  ucontext_t ctx;                 // saved context while not running
+  char stack[HOSTSTACKSIZE];
+};
+static struct HostThread HostThreads[MAXHOSTTHREADS];
+static struct HostThread *volatile Current;
+static volatile uint64_t SwitchStartNs;
+struct HostStats Host_Stats;
+
+// called in the context of the thread that was just switched in
+static void SwitchDone(void){
+  uint64_t ns = Host_TimeNs() - SwitchStartNs;
+  Host_Stats.switches++;
+  Host_Stats.switchSumNs += ns;
+  if((Host_Stats.switchMinNs == 0) || (ns < Host_Stats.switchMinNs)){
+    Host_Stats.switchMinNs = ns;
+  }
+  if(ns > Host_Stats.switchMaxNs){
+    Host_Stats.switchMaxNs = ns;
+  }
+}
+
+// first code run by every thread, like the BX LR at the end of StartOS
+static void ThreadStart(void){
+  Host_IsrNesting = 0;            // new threads start in thread mode
+  if(SwitchStartNs){
+    SwitchDone();
+  }
+  Current->entry();
+  fprintf(stderr, "lab3host: main thread returned\n");
+  abort();                        // on the board this would hard fault
+}
+
+// ******** HostThread_Get ************
+// Find or create the host context for a TCB
+// Inputs:  TCB whose first field is its saved stack pointer
+// Outputs: host context that resumes that thread
+static struct HostThread *HostThread_Get(struct tcb *t){
+  int32_t **spPt = (int32_t **)t;  // &t->sp
+  int32_t *sp = *spPt;
+  struct HostThread *ht = (struct HostThread *)sp;
+  int i;
+  if(ht->magic == HOSTMAGIC){
+    return ht;                     // has run before
+  }
+  if((sp[1] != (int32_t)0xFFFFFFF9) || (sp[2] != 0x04040404) || (sp[17] != 0x01000000)){
+    fprintf(stderr, "lab3host: TCB %p has neither a host context nor an initial stack\n", (void *)t);
+    abort();
+  }
+  // fresh frame from SetInitialStack: pad, EXC_RETURN, R4..R11, R0..R3, R12, LR, PC, PSR
+  // reuse the slot if SetInitialStack was called again on this TCB
+  for(i=0; i<MAXHOSTTHREADS; i=i+1){
+    if((HostThreads[i].tcb == t) || (HostThreads[i].tcb == 0)) break;
+  }
+  if(i == MAXHOSTTHREADS){
+    fprintf(stderr, "lab3host: more than %d threads\n", MAXHOSTTHREADS);
+    abort();
+  }
+  ht = &HostThreads[i];
+  ht->magic = HOSTMAGIC;
+  ht->tcb = t;
+  ht->entry = (void (*)(void))(uintptr_t)(uint32_t)sp[16]; // needs -no-pie
+  getcontext(&ht->ctx);
+  ht->ctx.uc_stack.ss_sp = ht->stack;
+  ht->ctx.uc_stack.ss_size = sizeof(ht->stack);
+  ht->ctx.uc_link = 0;
+  sigemptyset(&ht->ctx.uc_sigmask); // tasks run with interrupts enabled
+  makecontext(&ht->ctx, &ThreadStart, 0);
+  *spPt = (int32_t *)ht;
+  return ht;
+}
+
+static void SysTick_Isr(int sig){
+  Host_IsrNesting++;
+  Host_Stats.ticks++;
+  SysTick_Handler();               // pends PendSV, taken when this returns
+  Host_IsrNesting--;
+}
+
+static void PendSV_Handler(int sig){
+  struct HostThread *old = Current;
+  uint64_t start = Host_TimeNs();
+  Host_IsrNesting++;
+  Scheduler();
+  Current = HostThread_Get(RunPt);
+  if(Current != old){
+    SwitchStartNs = start;
+    swapcontext(&old->ctx, &Current->ctx);
+    SwitchDone();                  // back in old, some later switch resumed it
+  }
+  Host_IsrNesting--;
+}
+
+void StartOS(void){
+  Host_InstallIsr(HOST_SIG_SYSTICK, &SysTick_Isr);
+  Host_InstallIsr(HOST_SIG_PENDSV, &PendSV_Handler);
+  Current = HostThread_Get(RunPt);
+  Host_SysTickRestart();           // SysTick as configured by OS_Launch
+  setcontext(&Current->ctx);       // start first thread, interrupts enabled
+}
@@ -0,0 +1,9 @@
+// osstatic.h
+// Runs on Linux/POSIX
+// Threads and event threads of the static test in ostest.c, forced
+// into the build of os.c for lab3static with -include; see OSTHREADS
+// in ../osconfig.h.  The event threads are not listed in period order,
+// so OS_Init has to make them a heap.
+
+#define OSTHREADS(THREAD) THREAD(StaticA, 64, 10) THREAD(StaticB, 40, 10)
+#define OSPERIODIC(EVENT) EVENT(StaticTick, 5) EVENT(StaticSlow, 20) EVENT(StaticFast, 1)
@@ -0,0 +1,849 @@
+// ostest.c
+// Runs on Linux/POSIX
+// Kernel tests for the host port of the Lab 3 RTOS.  Each test is a
+// program like the ones in Lab3.c: it calls OS_Init, adds threads and
+// launches the OS.  Its threads check what the kernel did and set
+// TestDone when they finish; Lab3host reports TestErrors and the line
+// of each failed check, and exits with status 1 if any check failed
+// or the test did not finish.
+//   lab3host mutex|fifo|pool|defer|tickless|sleep|ring|trace|mailbox|edf|event|i2c
+//   lab3static static
+
+#include <stdint.h>
+#include "BSP.h"
+#include "Host.h"       // HOST_SIG_EXTERNAL for an interrupt from outside the kernel
+#include "os.h"
+#include "osconfig.h"   // NUMWORK, FRAMESIZE
+
+#define MAXFAILS 8
+
+extern uint32_t OSTime;       // os.c, msec since OS_Launch
+
+int32_t TestDone;             // 1 once every check has run
+int32_t TestErrors;           // checks that failed
+uint32_t TestFailLine[MAXFAILS]; // source lines of the first failures
+
+// record a failed check; threads do not printf, Lab3host does
+#define CHECK(cond) Check((cond) != 0, __LINE__)
+static void Check(int ok, uint32_t line){
+  if(ok){
+    return;
+  }
+  if(TestErrors < MAXFAILS){
+    TestFailLine[TestErrors] = line;
+  }
+  TestErrors = TestErrors + 1;
+}
+
+// a finished thread sleeps, since threads can not return
+static void Park(void){
+  while(1){
+    OS_Sleep(1000);
+  }
+}
+
+//---------------- mutex ----------------
+// Priority inheritance along a chain of owners.  MutexLow holds A,
+// MutexMid holds B and waits for A behind MutexWaiter, then MutexHigh
+// waits for B.  That boosts MutexMid above MutexWaiter, so A must go
+// to MutexMid first: the expected order is Low, Mid, High, Waiter.
+static MutexType MutexA, MutexB;
+static char MutexOrder[8];    // who got through, in order
+static uint32_t MutexOrderI;
+
+static void MutexLog(char who){
+  if(MutexOrderI < sizeof(MutexOrder)-1){
+    MutexOrder[MutexOrderI] = who;
+    MutexOrderI = MutexOrderI + 1;
+  }
+}
+static void MutexLow(void){     // priority 20
+  OS_Mutex_Lock(&MutexA);
+  OS_Sleep(20);                 // the others block meanwhile
+  MutexLog('L');
+  OS_Mutex_Unlock(&MutexA);
+  Park();
+}
+static void MutexMid(void){     // priority 15
+  OS_Sleep(2);
+  OS_Mutex_Lock(&MutexB);
+  OS_Mutex_Lock(&MutexA);       // waits behind MutexWaiter until boosted
+  MutexLog('M');
+  OS_Mutex_Unlock(&MutexA);
+  OS_Mutex_Unlock(&MutexB);
+  Park();
+}
+static void MutexWaiter(void){  // priority 12
+  OS_Sleep(4);
+  OS_Mutex_Lock(&MutexA);
+  MutexLog('W');
+  OS_Mutex_Unlock(&MutexA);
+  Park();
+}
+static void MutexHigh(void){    // priority 10
+  int i;
+  OS_Sleep(6);
+  OS_Mutex_Lock(&MutexB);       // boosts MutexMid, and through A MutexLow
+  MutexLog('H');
+  OS_Mutex_Unlock(&MutexB);
+  OS_Sleep(10);                 // MutexWaiter finishes
+  for(i=0; i<4; i=i+1){
+    CHECK(MutexOrder[i] == "LMHW"[i]);
+  }
+  CHECK(MutexOrderI == 4);
+  CHECK(MutexA.Owner == 0);
+  CHECK(MutexB.Owner == 0);
+  TestDone = 1;
+  Park();
+}
+int main_mutex(void){
+  OS_Init();
+  OS_Mutex_Init(&MutexA);
+  OS_Mutex_Init(&MutexB);
+  CHECK(OS_AddThread(&MutexLow, 128, 20));
+  CHECK(OS_AddThread(&MutexMid, 128, 15));
+  CHECK(OS_AddThread(&MutexWaiter, 128, 12));
+  CHECK(OS_AddThread(&MutexHigh, 128, 10));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- fifo ----------------
+// OS_FIFO_Create limits, and OS_FIFO_PutN/GetN batches that are cut
+// short by a full or nearly empty FIFO and that wrap around its end.
+// FifoTest puts and gets on an 8-entry FIFO by itself, then blocks
+// in OS_FIFO_GetN until FifoLate puts.
+static RingType *FifoTestFifo;
+
+static void FifoLate(void){     // priority 12
+  static const uint32_t late[2] = {100, 101};
+  OS_Sleep(5);
+  OS_FIFO_PutN(FifoTestFifo, late, 2);
+  Park();
+}
+static void FifoTest(void){     // priority 10
+  RingType *fifo = FifoTestFifo;
+  uint32_t in[10], out[10];
+  uint32_t i;
+  for(i=0; i<10; i=i+1){
+    in[i] = i + 1;
+  }
+  CHECK(OS_FIFO_PutN(fifo, in, 5) == 5);
+  CHECK(OS_FIFO_GetN(fifo, out, 3) == 3);       // stops at max
+  CHECK((out[0] == 1) && (out[1] == 2) && (out[2] == 3));
+  CHECK(OS_FIFO_GetN(fifo, out, 8) == 2);       // stops at what is there
+  CHECK((out[0] == 4) && (out[1] == 5));
+  CHECK(OS_FIFO_PutN(fifo, in, 8) == 8);        // entries 5..12, wraps after 7
+  CHECK(OS_FIFO_PutN(fifo, in, 2) == 0);        // full
+  CHECK(fifo->LostData == 2);
+  CHECK(OS_FIFO_GetN(fifo, out, 10) == 8);
+  for(i=0; i<8; i=i+1){
+    CHECK(out[i] == i + 1);
+  }
+  CHECK(OS_FIFO_PutN(fifo, in, 10) == 8);       // the last 2 do not fit
+  CHECK(fifo->LostData == 4);
+  CHECK(OS_FIFO_GetN(fifo, out, 10) == 8);
+  CHECK((out[0] == 1) && (out[7] == 8));
+  CHECK(OS_FIFO_GetN(fifo, out, 10) == 2);      // blocks until FifoLate puts
+  CHECK((out[0] == 100) && (out[1] == 101));
+  TestDone = 1;
+  Park();
+}
+int main_fifo(void){
+  OS_Init();
+  CHECK(OS_FIFO_Create(0x80000001) == 0);       // more than FIFOPOOLSIZE words
+  FifoTestFifo = OS_FIFO_Create(5);             // 8 entries
+  CHECK(FifoTestFifo != 0);
+  CHECK(FifoTestFifo->Mask == 7);
+  CHECK(OS_AddThread(&FifoTest, 128, 10));
+  CHECK(OS_AddThread(&FifoLate, 128, 12));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- pool ----------------
+// A pool of four blocks: running out, blocking in OS_PoolAllocWait
+// until OS_PoolFree, the freed block kept for the woken thread, and
+// OS_PoolFree of pointers that are not the pool's blocks or of a block
+// that is free already.
+#define POOLBLOCKWORDS 4
+static uint32_t PoolBuffer[4*POOLBLOCKWORDS];
+static uint32_t PoolOther[POOLBLOCKWORDS];
+static PoolType PoolTestPool;
+static void *volatile PoolGot; // block PoolWaiter got
+
+static void PoolWaiter(void){   // priority 12
+  void *block;
+  OS_Sleep(1);                  // PoolTest has taken every block by now
+  block = OS_PoolAllocWait(&PoolTestPool);
+  PoolGot = block;
+  CHECK(OS_PoolFree(&PoolTestPool, block) == 0);
+  Park();
+}
+static void PoolTest(void){     // priority 10
+  PoolType *pool = &PoolTestPool;
+  uint32_t *block[4];
+  int i;
+  for(i=0; i<4; i=i+1){
+    block[i] = OS_PoolAlloc(pool);
+    CHECK(block[i] == &PoolBuffer[i*POOLBLOCKWORDS]); // in address order
+  }
+  CHECK(OS_PoolAlloc(pool) == 0); // exhausted
+  CHECK((pool->Failed == 1) && (pool->MinFree == 0));
+  CHECK(OS_PoolFree(pool, &PoolBuffer[1]) == -1);     // inside a block
+  CHECK(OS_PoolFree(pool, &PoolBuffer[4*POOLBLOCKWORDS]) == -1); // just past the pool
+  CHECK(OS_PoolFree(pool, PoolOther) == -1);          // not from the pool
+  CHECK(pool->NumFree == 0);
+  OS_Sleep(3);                  // PoolWaiter blocks on the empty pool
+  CHECK(PoolGot == 0);
+  CHECK(OS_PoolFree(pool, block[2]) == 0);             // wakes PoolWaiter
+  CHECK(OS_PoolAlloc(pool) == 0); // the block is kept for PoolWaiter
+  OS_Sleep(2);
+  CHECK(PoolGot == block[2]);
+  CHECK(pool->NumFree == 1);    // PoolWaiter gave it back
+  CHECK(OS_PoolAlloc(pool) == block[2]);
+  for(i=0; i<4; i=i+1){
+    CHECK(OS_PoolFree(pool, block[i]) == 0);
+  }
+  CHECK(OS_PoolFree(pool, block[1]) == -1);           // freed twice
+  CHECK(pool->NumFree == 4);
+  for(i=0; i<4; i=i+1){
+    CHECK(OS_PoolAlloc(pool) != 0);
+  }
+  CHECK(OS_PoolAlloc(pool) == 0); // still four blocks, not five
+  TestDone = 1;
+  Park();
+}
+int main_pool(void){
+  OS_Init();
+  CHECK(OS_PoolCreate(&PoolTestPool, PoolBuffer, POOLBLOCKWORDS, 4) == 0);
+  CHECK(OS_AddThread(&PoolTest, 128, 10));
+  CHECK(OS_AddThread(&PoolWaiter, 128, 12));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- defer ----------------
+// A periodic event thread defers a counter increment every msec, and
+// once posts a burst that fills the work queue.  The worker must run
+// every accepted increment, always in the same thread, which is not
+// DeferCheck, and never inside the event thread; the burst must be
+// cut off at NUMWORK entries with a return value of 0.
+static uint32_t DeferCount;     // incremented by the worker
+static uint32_t DeferAccepted;  // OS_Defer calls that returned 1
+static uint32_t DeferRejected;  // OS_Defer calls that returned 0
+static uint32_t DeferBurst;     // accepted out of the burst
+static uint32_t DeferTicks;
+static int32_t DeferInEvent;    // 1 while DeferEvent runs
+static uint32_t DeferWorkerId;  // OS_Id of the thread that ran the first increment
+static uint32_t DeferCheckId;
+static uint32_t DeferWrongThread; // increments run elsewhere than that thread
+
+static void DeferAdd(uint32_t n){
+  if(DeferCount == 0){
+    DeferWorkerId = OS_Id();
+  }
+  if(DeferInEvent || (OS_Id() != DeferWorkerId)){
+    DeferWrongThread = DeferWrongThread + 1;
+  }
+  DeferCount = DeferCount + n;
+}
+static void DeferPost(uint32_t n){
+  if(OS_Defer(&DeferAdd, n)){
+    DeferAccepted = DeferAccepted + n;
+  } else{
+    DeferRejected = DeferRejected + 1;
+  }
+}
+static void DeferEvent(void){   // every 1 ms
+  uint32_t i;
+  DeferInEvent = 1;
+  DeferTicks = DeferTicks + 1;
+  if(DeferTicks <= 20){
+    DeferPost(1);
+  } else if(DeferTicks == 21){
+    for(i=0; i<NUMWORK+1; i=i+1){ // the worker can not run until this returns
+      DeferPost(1);
+    }
+    DeferBurst = DeferAccepted - 20;
+  }
+  DeferInEvent = 0;
+}
+static void DeferCheck(void){   // priority 10
+  DeferCheckId = OS_Id();
+  OS_Sleep(40);                 // the worker has emptied the queue long ago
+  CHECK(DeferBurst == NUMWORK);
+  CHECK(DeferRejected == 1);
+  CHECK(DeferAccepted == 20+NUMWORK);
+  CHECK(DeferCount == DeferAccepted);
+  CHECK(DeferWrongThread == 0);
+  CHECK(DeferWorkerId != DeferCheckId);
+  TestDone = 1;
+  Park();
+}
+int main_defer(void){
+  OS_Init();
+  CHECK(OS_AddThread(&DeferCheck, 128, 10));
+  CHECK(OS_AddPeriodicEventThread(&DeferEvent, 1));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- tickless ----------------
+// A wakeup that does not come from the periodic interrupt.  While
+// only idle is ready SysTick is off and the periodic interrupt may be
+// a second apart; TicklessIsr, a timer standing in for a GPIO edge,
+// sets an event flag 30 ms after TicklessTest starts to wait for it.
+// The woken thread must find OSTime caught up with real time, and a
+// 2 ms sleep right after must take 2 ms, not the rest of that second.
+static EventGroupType TicklessGroup;
+static timer_t TicklessTimer;
+
+static void TicklessIsr(int sig){
+  Host_IsrNesting++;
+  Host_TimerArm(TicklessTimer, 0);  // once
+  OS_EventGroup_Set(&TicklessGroup, 1);
+  Host_IsrNesting--;
+}
+static void TicklessTest(void){ // priority 10
+  uint32_t time, us, ms;
+  OS_Sleep(5);                  // the periodic interrupt is stretched while this sleeps
+  time = OSTime;
+  us = BSP_Time_Get();
+  Host_TimerArm(TicklessTimer, 30000000);
+  CHECK(OS_EventGroup_Wait(&TicklessGroup, 1, 0) == 1);
+  us = BSP_Time_Get() - us;
+  ms = OSTime - time;
+  CHECK(us >= 25000);
+  CHECK((ms + 2 >= us/1000) && (ms <= us/1000 + 1)); // within the msec in progress
+  us = BSP_Time_Get();
+  time = OSTime;
+  OS_Sleep(2);
+  us = BSP_Time_Get() - us;
+  CHECK(OSTime - time >= 2);
+  CHECK(us < 10000);
+  TestDone = 1;
+  Park();
+}
+int main_tickless(void){
+  OS_Init();
+  OS_EventGroup_Init(&TicklessGroup);
+  TicklessTimer = Host_TimerCreate(HOST_SIG_EXTERNAL);
+  Host_InstallIsr(HOST_SIG_EXTERNAL, &TicklessIsr);
+  CHECK(OS_AddThread(&TicklessTest, 128, 10));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- sleep ----------------
+// The sleep delta list.  SleepA, SleepB, SleepC and SleepD go to sleep
+// in the same msec for 5, 3, 5 and 8 ms, after SleepCheck, above them,
+// went to sleep for 4.  Each must wake exactly that many msec later, so
+// they run B, Check, A, C, D; SleepC is below SleepA so the two woken
+// in the same msec run in a known order.
+static char SleepOrder[8];      // who woke, in order
+static uint32_t SleepOrderI;
+static uint32_t SleepLate;      // wakeups not in the msec they were due
+
+static void SleepFor(char who, uint32_t ms){
+  uint32_t time;
+  OS_Sleep(1);                  // start right after a tick, all in the same msec
+  time = OSTime;
+  OS_Sleep(ms);
+  if(OSTime - time != ms){
+    SleepLate = SleepLate + 1;
+  }
+  if(SleepOrderI < sizeof(SleepOrder)-1){
+    SleepOrder[SleepOrderI] = who;
+    SleepOrderI = SleepOrderI + 1;
+  }
+}
+static void SleepA(void){       // priority 11
+  SleepFor('A', 5);
+  Park();
+}
+static void SleepB(void){       // priority 11
+  SleepFor('B', 3);
+  Park();
+}
+static void SleepC(void){       // priority 12
+  SleepFor('C', 5);
+  Park();
+}
+static void SleepD(void){       // priority 11
+  SleepFor('D', 8);
+  Park();
+}
+static void SleepCheck(void){   // priority 10
+  int i;
+  SleepFor('K', 4);
+  OS_Sleep(10);                 // the others are awake by now
+  for(i=0; i<5; i=i+1){
+    CHECK(SleepOrder[i] == "BKACD"[i]);
+  }
+  CHECK(SleepOrderI == 5);
+  CHECK(SleepLate == 0);
+  TestDone = 1;
+  Park();
+}
+int main_sleep(void){
+  OS_Init();
+  CHECK(OS_AddThread(&SleepCheck, 128, 10));
+  CHECK(OS_AddThread(&SleepA, 128, 11));
+  CHECK(OS_AddThread(&SleepB, 128, 11));
+  CHECK(OS_AddThread(&SleepC, 128, 12));
+  CHECK(OS_AddThread(&SleepD, 128, 11));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- ring ----------------
+// OS_Ring_Put and OS_Ring_Get on a 4-entry ring.  RingConsumer gets
+// from the empty ring and blocks until RingProducer, below it, puts.
+// While RingConsumer then sleeps, RingProducer fills the ring, which
+// drops the fifth put, and RingConsumer gets the four that fit in order.
+static RingType RingTestRing;
+static uint32_t RingTestBuffer[4];
+static uint32_t RingGot[8];     // entries RingConsumer got, in order
+static uint32_t RingGotI;
+
+static void RingProducer(void){ // priority 12
+  RingType *ring = &RingTestRing;
+  uint32_t i;
+  CHECK(ring->Waiter != 0);     // the consumer is blocked on the empty ring
+  CHECK(OS_Ring_Put(ring, 1) == 0);     // wakes it
+  CHECK(ring->Waiter == 0);
+  OS_Sleep(2);
+  CHECK(RingGotI == 1);         // and it got the entry
+  for(i=2; i<6; i=i+1){         // it is asleep
+    CHECK(OS_Ring_Put(ring, i) == 0);
+  }
+  CHECK(OS_Ring_Put(ring, 6) == -1);    // full
+  CHECK(ring->LostData == 1);
+  OS_Sleep(20);
+  CHECK(RingGotI == 5);
+  CHECK(ring->PutI == ring->GetI);
+  CHECK(ring->Waiter != 0);     // blocked on the empty ring again
+  for(i=0; i<5; i=i+1){
+    CHECK(RingGot[i] == i + 1);
+  }
+  TestDone = 1;
+  Park();
+}
+static void RingConsumer(void){ // priority 10
+  RingGot[0] = OS_Ring_Get(&RingTestRing);
+  RingGotI = 1;
+  OS_Sleep(10);
+  for(;;){
+    RingGot[RingGotI&7] = OS_Ring_Get(&RingTestRing);
+    RingGotI = RingGotI + 1;
+  }
+}
+int main_ring(void){
+  OS_Init();
+  CHECK(OS_Ring_Init(&RingTestRing, RingTestBuffer, 3) == -1);  // not a power of 2
+  CHECK(OS_Ring_Init(&RingTestRing, RingTestBuffer, 4) == 0);
+  CHECK(OS_AddThread(&RingConsumer, 128, 10));
+  CHECK(OS_AddThread(&RingProducer, 128, 12));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- trace ----------------
+// The Trace ring and OS_RunTime.  TraceTest, the only thread besides
+// idle and the blocked worker, makes a known sequence of calls and
+// then finds exactly their records, with their args, after the PutI
+// it started at.  Its run time grows by the time it spun.
+static Sema4Type TraceSema;
+static EventGroupType TraceGroup;
+static const struct TraceRecord TraceWant[] = {
+  {0, TRACE_WAIT,   0, 0},             // OS_WaitSema4, the new value
+  {0, TRACE_SIGNAL, 0, 1},             // OS_SignalSema4, the new value
+  {0, TRACE_SIGNAL, 0, 3},             // OS_EventGroup_Set, the flags now set
+  {0, TRACE_WAIT,   0, 1},             // OS_EventGroup_Wait, the flags wanted
+  {0, TRACE_SIGNAL, 0, 6},             // 0x02 was left set
+  {0, TRACE_SLEEP,  0, 3},             // msec
+  {0, TRACE_SWITCH, 0, IDLEPRIORITY},  // to idle
+  {0, TRACE_SWITCH, 0, 10}             // back to TraceTest
+};
+#define TRACEWANT (sizeof(TraceWant)/sizeof(TraceWant[0]))
+
+static void TraceTest(void){    // priority 10
+  const struct TraceHeader *trace = OS_Trace();
+  const struct TraceRecord *records = (const struct TraceRecord *)(trace + 1);
+  const struct TraceRecord *r;
+  uint32_t id = OS_Id();
+  uint32_t start, i, time, runTime;
+  CHECK(trace->Magic == TRACEMAGIC);
+  runTime = OS_RunTime(id);
+  start = trace->PutI;
+  OS_InitSema4(&TraceSema, 1);
+  OS_WaitSema4(&TraceSema);
+  OS_SignalSema4(&TraceSema);
+  OS_EventGroup_Init(&TraceGroup);
+  OS_EventGroup_Set(&TraceGroup, 0x03);
+  CHECK(OS_EventGroup_Wait(&TraceGroup, 0x01, 0) == 0x01);
+  OS_EventGroup_Set(&TraceGroup, 0x04);
+  time = BSP_Time_Get();
+  while((BSP_Time_Get() - time) < 3000){}      // spin 3 ms
+  OS_Sleep(3);
+  CHECK(trace->PutI - start == TRACEWANT);
+  time = records[start&(trace->Size-1)].Time;
+  for(i=0; i<TRACEWANT; i=i+1){
+    r = &records[(start+i)&(trace->Size-1)];
+    CHECK(r->Event == TraceWant[i].Event);
+    CHECK(r->Arg == TraceWant[i].Arg);
+    CHECK(r->Thread == ((i == TRACEWANT-2) ? 0 : id));   // idle is 0
+    CHECK((int32_t)(r->Time - time) >= 0);
+    time = r->Time;
+  }
+  CHECK(OS_RunTime(id) - runTime >= 3000);
+  CHECK(OS_RunTime(0) >= 2000);        // idle ran while TraceTest slept
+  CHECK(OS_RunTime(NUMTHREADS) == 0);  // no such thread
+  TestDone = 1;
+  Park();
+}
+int main_trace(void){
+  OS_Init();
+  CHECK(OS_AddThread(&TraceTest, 128, 10));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- mailbox ----------------
+// OS_Mailbox_Post, Accept and Receive.  MailTest posts twice before
+// accepting, so the first block is lost and only the newest arrives,
+// then blocks in OS_Mailbox_Receive until MailLate, below it, posts.
+// The producer's block is never the one the consumer holds.
+static MailboxType MailTestBox;
+static uint32_t MailTestBuffer[3*4];
+static uint32_t *MailFill;      // block the producer is filling
+
+static void MailLate(void){     // priority 12
+  OS_Sleep(5);
+  MailFill[0] = 3;
+  MailFill = OS_Mailbox_Post(&MailTestBox);
+  Park();
+}
+static void MailTest(void){     // priority 10
+  MailboxType *box = &MailTestBox;
+  uint32_t *got;
+  uint32_t time;
+  CHECK(OS_Mailbox_Accept(box) == 0);   // nothing posted yet
+  MailFill[0] = 1;
+  MailFill = OS_Mailbox_Post(box);
+  CHECK(box->LostBlocks == 0);
+  MailFill[0] = 2;
+  MailFill = OS_Mailbox_Post(box);      // replaces 1 before it was received
+  CHECK(box->LostBlocks == 1);
+  got = OS_Mailbox_Accept(box);
+  CHECK(got != 0);
+  CHECK(got[0] == 2);
+  CHECK(got != MailFill);
+  CHECK(OS_Mailbox_Accept(box) == 0);   // nothing new
+  time = OSTime;
+  got = OS_Mailbox_Receive(box);        // blocks until MailLate posts
+  CHECK(OSTime - time >= 4);
+  CHECK(got[0] == 3);
+  CHECK(got != box->Fill);      // MailLate may not have stored MailFill yet
+  CHECK(box->Ready != box->Fill);
+  CHECK(box->Ready != got);
+  CHECK(box->LostBlocks == 1);
+  TestDone = 1;
+  Park();
+}
+int main_mailbox(void){
+  OS_Init();
+  MailFill = OS_Mailbox_Init(&MailTestBox, MailTestBuffer, 4);
+  CHECK((MailFill >= MailTestBuffer) && (MailFill < MailTestBuffer + 3*4));
+  CHECK(OS_AddThread(&MailTest, 128, 10));
+  CHECK(OS_AddThread(&MailLate, 128, 12));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- edf ----------------
+// OS_AddEDFThread admission control, due order at EDFPRIORITY and
+// OS_DeadlineMisses.  EDFFar (deadline 50) is added before EDFNear
+// (deadline 20), yet EDFNear runs first.  It spins 35 ms, past its
+// due, then waits on a semaphore that is already signalled: that
+// ends the late job, a miss, and releases the next one due after
+// EDFFar's, so EDFFar runs before EDFNear goes on.
+static Sema4Type EDFSema;
+static char EDFOrder[8];        // who ran, in order
+static uint32_t EDFOrderI;
+static uint32_t EDFNearId, EDFFarId;
+
+static void EDFRan(char who){
+  if(EDFOrderI < sizeof(EDFOrder)-1){
+    EDFOrder[EDFOrderI] = who;
+    EDFOrderI = EDFOrderI + 1;
+  }
+}
+static void EDFNear(void){      // EDFPRIORITY, deadline 20
+  uint32_t time;
+  EDFNearId = OS_Id();
+  EDFRan('N');
+  time = BSP_Time_Get();
+  while((BSP_Time_Get() - time) < 35000){}     // due at 20 ms
+  OS_WaitSema4(&EDFSema);       // does not block, next job due at 55 ms
+  EDFRan('n');
+  Park();
+}
+static void EDFFar(void){       // EDFPRIORITY, deadline 50
+  EDFFarId = OS_Id();
+  EDFRan('F');
+  Park();
+}
+static void EDFNever(void){     // refused
+  Park();
+}
+static void EDFCheck(void){     // priority 5
+  OS_Sleep(80);
+  CHECK(EDFOrder[0] == 'N');
+  CHECK(EDFOrder[1] == 'F');
+  CHECK(EDFOrder[2] == 'n');
+  CHECK(EDFOrderI == 3);
+  CHECK(OS_DeadlineMisses(EDFNearId) == 1);
+  CHECK(OS_DeadlineMisses(EDFFarId) == 0);
+  TestDone = 1;
+  Park();
+}
+int main_edf(void){
+  OS_Init();
+  OS_InitSema4(&EDFSema, 1);
+  CHECK(OS_AddThread(&EDFNever, 128, EDFPRIORITY) == 0);      // kept for EDF
+  CHECK(OS_AddEDFThread(&EDFNever, 128, 10, 20, 100) == 0);   // deadline after period
+  CHECK(OS_AddEDFThread(&EDFNever, 128, 10, 1, 1000) == 0);   // a whole CPU
+  CHECK(OS_AddEDFThread(&EDFFar, 128, 100, 50, 20000));       // 400000 ppm
+  CHECK(OS_AddEDFThread(&EDFNever, 128, 100, 20, 11000) == 0); // 550000 more
+  CHECK(OS_AddEDFThread(&EDFNear, 128, 100, 20, 8000));       // 400000 more
+  CHECK(OS_AddThread(&EDFCheck, 128, 5));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- event ----------------
+// OS_EventGroup_Set, Wait and Clear.  EventSetter first waits on a
+// group of its own whose flags are already set: any and all waits
+// take only the wanted flags, and leave the rest set.  Then EventW0
+// (any of 0x01), EventW1 (all of 0x06) and EventW2 (any of 0x01),
+// above it, wait on EventGroup in that order.  Setting 0x02 wakes
+// nobody and is kept; 0x01 wakes only EventW0, which consumes it
+// before EventW2 is checked; 0x05 then completes EventW1 and wakes
+// EventW2 too, two waiters from one set.
+static EventGroupType EventGroup, EventOwn;
+static uint32_t EventGot[3];    // what each waiter's wait returned
+static uint32_t EventWakes[3];  // times each waiter woke
+
+static void EventW0(void){      // priority 10
+  EventGot[0] = OS_EventGroup_Wait(&EventGroup, 0x01, 0);
+  EventWakes[0] = EventWakes[0] + 1;
+  Park();
+}
+static void EventW1(void){      // priority 10
+  EventGot[1] = OS_EventGroup_Wait(&EventGroup, 0x06, 1);
+  EventWakes[1] = EventWakes[1] + 1;
+  Park();
+}
+static void EventW2(void){      // priority 10
+  EventGot[2] = OS_EventGroup_Wait(&EventGroup, 0x01, 0);
+  EventWakes[2] = EventWakes[2] + 1;
+  Park();
+}
+static void EventSetter(void){  // priority 12
+  OS_EventGroup_Init(&EventOwn);
+  OS_EventGroup_Set(&EventOwn, 0x03);
+  CHECK(OS_EventGroup_Wait(&EventOwn, 0x05, 0) == 0x01);     // any: takes what is set
+  CHECK(EventOwn.Bits == 0x02);                              // keeps what was not wanted
+  OS_EventGroup_Set(&EventOwn, 0x04);
+  CHECK(OS_EventGroup_Wait(&EventOwn, 0x06, 1) == 0x06);     // all: both set now
+  CHECK(EventOwn.Bits == 0);
+  OS_EventGroup_Set(&EventOwn, 0x09);
+  CHECK(OS_EventGroup_Clear(&EventOwn, 0x03) == 0x01);
+  CHECK(EventOwn.Bits == 0x08);
+
+  CHECK(EventGroup.Head != 0);  // all three are waiting
+  OS_EventGroup_Set(&EventGroup, 0x02);
+  OS_Sleep(1);
+  CHECK((EventWakes[0] == 0) && (EventWakes[1] == 0) && (EventWakes[2] == 0));
+  CHECK(EventGroup.Bits == 0x02);                            // kept for EventW1
+  OS_EventGroup_Set(&EventGroup, 0x01);
+  OS_Sleep(1);
+  CHECK((EventWakes[0] == 1) && (EventWakes[1] == 0) && (EventWakes[2] == 0));
+  CHECK(EventGot[0] == 0x01);
+  CHECK(EventGroup.Bits == 0x02);                            // EventW0 consumed 0x01
+  OS_EventGroup_Set(&EventGroup, 0x05);
+  OS_Sleep(1);
+  CHECK((EventWakes[0] == 1) && (EventWakes[1] == 1) && (EventWakes[2] == 1));
+  CHECK(EventGot[1] == 0x06);
+  CHECK(EventGot[2] == 0x01);
+  CHECK(EventGroup.Bits == 0);
+  CHECK(EventGroup.Head == 0);
+  TestDone = 1;
+  Park();
+}
+int main_event(void){
+  OS_Init();
+  OS_EventGroup_Init(&EventGroup);
+  CHECK(OS_AddThread(&EventW0, 128, 10));
+  CHECK(OS_AddThread(&EventW1, 128, 10));
+  CHECK(OS_AddThread(&EventW2, 128, 10));
+  CHECK(OS_AddThread(&EventSetter, 128, 12));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- i2c ----------------
+// OS_I2C_Submit and OS_I2C_Wait.  I2CClientA and I2CClientB, above
+// the driver thread, submit I2CReq1 (Delay 3) and I2CReq2 (Delay 1)
+// and wait, so the driver finds both queued: it starts them in the
+// order submitted, and finishes I2CReq2 first.  With nothing queued
+// the driver sleeps and calls no End; I2CClientA then submits I2CReq3,
+// whose End is done at the second call, and it must be woken for it
+// at once, not after its I2CIDLEMS sleep.
+static I2CRequestType I2CReq1, I2CReq2, I2CReq3;
+static char I2CStarted[4];      // which requests were started, in order
+static uint32_t I2CStartedI;
+static uint32_t I2CStartId;     // OS_Id of the thread that called Start
+static char I2CDone[4];         // which clients finished waiting, in order
+static uint32_t I2CDoneI;
+static uint32_t I2CEnds;        // End calls, all requests
+static uint32_t I2CEnd3s;       // End calls for I2CReq3
+static uint32_t I2CIdB;
+
+static void I2CStart(char which){
+  I2CStartId = OS_Id();
+  if(I2CStartedI < sizeof(I2CStarted)-1){
+    I2CStarted[I2CStartedI] = which;
+    I2CStartedI = I2CStartedI + 1;
+  }
+}
+static void I2CStart1(void){ I2CStart('1'); }
+static void I2CStart2(void){ I2CStart('2'); }
+static void I2CStart3(void){ I2CStart('3'); }
+static int I2CEnd(void *result){
+  I2CEnds = I2CEnds + 1;
+  return 1;
+}
+static int I2CEnd3(void *result){
+  I2CEnds = I2CEnds + 1;
+  I2CEnd3s = I2CEnd3s + 1;
+  return I2CEnd3s >= 2;        // still converting at the first call
+}
+static void I2CFinished(char who){
+  if(I2CDoneI < sizeof(I2CDone)-1){
+    I2CDone[I2CDoneI] = who;
+    I2CDoneI = I2CDoneI + 1;
+  }
+}
+static void I2CClientB(void){   // priority 0
+  I2CIdB = OS_Id();
+  I2CReq2.Start = &I2CStart2;
+  I2CReq2.End = &I2CEnd;
+  I2CReq2.Delay = 1;
+  OS_I2C_Submit(&I2CReq2);
+  OS_I2C_Wait(&I2CReq2);
+  I2CFinished('B');
+  Park();
+}
+static void I2CClientA(void){   // priority 0
+  uint32_t ends, time;
+  I2CReq1.Start = &I2CStart1;
+  I2CReq1.End = &I2CEnd;
+  I2CReq1.Delay = 3;
+  OS_I2C_Submit(&I2CReq1);
+  OS_I2C_Wait(&I2CReq1);        // I2CClientB submits while this waits
+  I2CFinished('A');
+  CHECK(I2CStarted[0] == '1');
+  CHECK(I2CStarted[1] == '2');
+  CHECK(I2CStartId == I2CIdB + 1);      // the driver, added after I2CClientB
+  CHECK(I2CDone[0] == 'B');
+  CHECK(I2CDone[1] == 'A');
+  CHECK(I2CEnds == 2);
+  ends = I2CEnds;
+  OS_Sleep(20);
+  CHECK(I2CEnds == ends);       // the driver does not poll when idle
+  I2CReq3.Start = &I2CStart3;
+  I2CReq3.End = &I2CEnd3;
+  I2CReq3.Delay = 0;
+  time = OSTime;
+  OS_I2C_Submit(&I2CReq3);      // wakes the sleeping driver
+  OS_I2C_Wait(&I2CReq3);
+  CHECK(OSTime - time <= 3);
+  CHECK(I2CStarted[2] == '3');
+  CHECK(I2CEnd3s == 2);
+  TestDone = 1;
+  Park();
+}
+int main_i2c(void){
+  OS_Init();
+  CHECK(OS_AddThread(&I2CClientA, 128, 0));
+  CHECK(OS_AddThread(&I2CClientB, 128, 0));
+  CHECK(OS_I2C_Init());
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+
+//---------------- static ----------------
+// Threads and event threads from OSTHREADS and OSPERIODIC, which
+// osstatic.h lists for the lab3static build of os.c.  StaticCheck is
+// added at run time after them, and checks their IDs, that they ran
+// round robin, and that each event thread ran once per period.
+static uint32_t StaticIdA, StaticIdB, StaticWorkerId;
+static uint32_t StaticCountA, StaticCountB;
+static uint32_t StaticTicks, StaticSlows, StaticFasts;
+
+void StaticA(void){             // priority 10
+  StaticIdA = OS_Id();
+  while(1){
+    StaticCountA = StaticCountA + 1;
+    OS_Sleep(1);
+  }
+}
+void StaticB(void){             // priority 10
+  StaticIdB = OS_Id();
+  while(1){
+    StaticCountB = StaticCountB + 1;
+    OS_Sleep(1);
+  }
+}
+void StaticTick(void){          // every 5 ms
+  StaticTicks = StaticTicks + 1;
+}
+void StaticSlow(void){          // every 20 ms
+  StaticSlows = StaticSlows + 1;
+}
+void StaticFast(void){          // every 1 ms
+  StaticFasts = StaticFasts + 1;
+}
+static void StaticWorker(uint32_t unused){
+  StaticWorkerId = OS_Id();
+}
+static void StaticCheck(void){  // priority 5
+  uint32_t fasts, ticks, slows;
+  CHECK(OS_Defer(&StaticWorker, 0)); // the worker runs it now, WORKERPRIORITY is higher
+  OS_Sleep(3);
+  CHECK(StaticFasts >= 2);      // on time, not caught up later, so the heap is in order
+  OS_Sleep(97);                 // wakes right after the event threads of msec 100
+  fasts = StaticFasts;
+  ticks = StaticTicks;
+  slows = StaticSlows;
+  CHECK(StaticIdA == StaticWorkerId+1); // after idle and the worker, in OSTHREADS order
+  CHECK(StaticIdB == StaticIdA+1);
+  CHECK(OS_Id() == StaticIdB+1);
+  CHECK(StaticCountA >= 50);
+  CHECK(StaticCountB >= 50);
+  CHECK((fasts >= 100) && (fasts <= 101));
+  CHECK(ticks == 20);
+  CHECK(slows == 5);
+  CHECK(OS_StackHighWater(StaticIdB) == FRAMESIZE); // host threads run on host stacks
+  TestDone = 1;
+  Park();
+}
+int main_static(void){
+  OS_Init();                    // StaticA and StaticB are ready already
+  CHECK(OS_AddThread(&StaticCheck, 128, 5));
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
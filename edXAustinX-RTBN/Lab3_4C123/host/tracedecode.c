@@ -0,0 +1,100 @@
+// tracedecode.c
+// Runs on Linux/POSIX
+// Prints a kernel trace saved from the Lab 3 RTOS: a timeline of the
+// records in the order they were written, then the share of the
+// traced interval each thread ran, from its TRACE_SWITCH records.
+//   tracedecode tracefile
+// The file is the TraceHeader followed by Size TraceRecords, either
+// saved by lab3host or dumped from the board, e.g. in the Keil
+// debugger: SAVE trace.hex &Trace, &Trace+sizeof(Trace)
+// then converted to binary.  Both are little endian.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+
+#define MAXTHREADS 256             // OS_Id fits in a record's Thread byte
+
+static const char *EventName(uint8_t event){
+  switch(event){
+    case TRACE_SWITCH:   return "switch";
+    case TRACE_WAIT:     return "wait";
+    case TRACE_SIGNAL:   return "signal";
+    case TRACE_SLEEP:    return "sleep";
+    case TRACE_PERIODIC: return "periodic";
+  }
+  return "?";
+}
+
+static void PrintThread(uint8_t thread){
+  if(thread == TRACE_NOTHREAD){
+    printf("  event ");
+  } else{
+    printf("  T%-4u ", thread);
+  }
+}
+
+int main(int argc, char **argv){
+  struct TraceHeader h;
+  struct TraceRecord *r;
+  uint64_t run[MAXTHREADS] = {0};
+  uint64_t total;
+  uint32_t first, n, i;
+  int current = -1;
+  uint32_t since = 0;
+  FILE *f;
+  if(argc != 2){
+    fprintf(stderr, "usage: %s tracefile\n", argv[0]);
+    return 2;
+  }
+  f = fopen(argv[1], "rb");
+  if(f == 0){
+    perror(argv[1]);
+    return 1;
+  }
+  if((fread(&h, sizeof(h), 1, f) != 1) || (h.Magic != TRACEMAGIC) ||
+     (h.Size == 0) || (h.Size&(h.Size-1))){
+    fprintf(stderr, "%s: not a Lab 3 RTOS trace\n", argv[1]);
+    return 1;
+  }
+  r = malloc(h.Size*sizeof(*r));
+  if((r == 0) || (fread(r, sizeof(*r), h.Size, f) != h.Size)){
+    fprintf(stderr, "%s: truncated\n", argv[1]);
+    return 1;
+  }
+  fclose(f);
+  n = (h.PutI < h.Size) ? h.PutI : h.Size;
+  first = h.PutI - n;
+  printf("%u records, %u overwritten\n", n, first);
+  printf("      usec  thread  event     arg\n");
+  for(i=first; i<h.PutI; i=i+1){
+    struct TraceRecord *e = &r[i&(h.Size-1)];
+    printf("%10u", e->Time);
+    PrintThread(e->Thread);
+    printf(" %-8s %5d\n", EventName(e->Event),
+      (e->Event == TRACE_WAIT || e->Event == TRACE_SIGNAL) ? (int16_t)e->Arg : e->Arg);
+    if(e->Event == TRACE_SWITCH){
+      if(current >= 0){
+        run[current] += e->Time - since;
+      }
+      current = e->Thread;
+      since = e->Time;
+    }
+  }
+  total = 0;
+  for(i=0; i<MAXTHREADS; i=i+1){
+    total += run[i];
+  }
+  if(total == 0){
+    printf("fewer than two thread switches, no utilisation\n");
+    return 0;
+  }
+  printf("thread   usec        CPU\n");
+  for(i=0; i<MAXTHREADS; i=i+1){
+    if(run[i]){
+      printf("  T%-4u %10llu  %5.1f%%\n", i, (unsigned long long)run[i], 100.0*run[i]/total);
+    }
+  }
+  return 0;
+}
@@ -6,15 +6,24 @@
 
 #include <stdint.h>
 #include "os.h"
+#include "osconfig.h"
 #include "CortexM.h"
 #include "BSP.h"
 
 // function definitions in osasm.s
 void StartOS(void);
+void Scheduler(void);
 
-#define NUMTHREADS  6        // maximum number of threads
-#define NUMPERIODIC 2        // maximum number of periodic threads
-#define STACKSIZE   100      // number of 32-bit words in stack per thread
+#define PENDSVSET 0x10000000 // write to INTCTRL to pend a thread switch
+
+#define STACKPAINT  0xC0DEC0DE // fills unused stack, the lowest word is the canary
+
+// count leading zeros, a single CLZ instruction on the Cortex M4
+#if defined(__CC_ARM)
+#define CLZ(x) __clz(x)
+#else
+#define CLZ(x) __builtin_clz(x)
+#endif
 
 /* --------------------------------------
     Thread Control Block Typedef
@@ -23,7 +32,30 @@ struct tcb{
   int32_t    *sp;        /* pointer to stack (valid for threads not running               */
   struct tcb *next;      /* linked-list pointer                                           */
   int32_t    *blocked;	 /* blocking semaphore - nonzero if blocked on this semaphore     */
-  int32_t    sleep;      /* nonzero if this thread is sleeping                            */
+  int32_t    sleep;      /* nonzero if this thread is sleeping, msec after the one before */
+                         /* it in SleepList (a delta list)                                */
+  uint32_t   priority;   /* 0 is highest, IDLEPRIORITY is lowest                          */
+  struct tcb *nextReady; /* circular list of ready threads with the same priority,         */
+                         /* or next thread in the wait queue while blocked,               */
+                         /* or next thread in SleepList while sleeping                    */
+  struct tcb *prevReady;
+  int32_t    *stack;     /* lowest word of this thread's stack, the canary                */
+  uint32_t   stackWords; /* size of the stack                                             */
+  uint32_t   basePriority; /* priority given by OS_AddThread, priority may be higher       */
+                         /* while holding a mutex that a higher priority thread wants     */
+  MutexType  *mutexWait; /* mutex this thread is blocked on, or null                      */
+  MutexType  *mutexHeld; /* mutexes this thread owns, linked through their Next           */
+  uint32_t   runTime;    /* usec this thread has run, including ISRs that interrupted it  */
+#if EDF
+  uint32_t   deadline;   /* msec from release to due for an EDF thread, 0 for the others  */
+  uint32_t   due;        /* OSTime the current job is due, EDF threads only               */
+  uint32_t   released;   /* 1 from release until the job is done                          */
+  uint32_t   misses;     /* jobs done after they were due                                 */
+#endif
+#if EVENTGROUPS
+  uint32_t   waitBits;   /* event group flags wanted while blocked, then the flags got    */
+  uint32_t   waitAll;    /* 1 if all of waitBits are wanted, 0 if any one                 */
+#endif
 };
 
 /* --------------------------------------
@@ -33,14 +65,86 @@ typedef void (*event_thread_ptr_type)(void);
 typedef struct {
 	event_thread_ptr_type		isr_ptr; 	/* function pointer to the ISR for this event thread */
 	uint32_t					period;	    /* number of times scheduler should be called before this thread should run */
-	uint32_t					theTime;	/* counter # of times scheduler has been called since this thread executed */
+	uint32_t					release;	/* OSTime when this thread should run next */
 } EventThread_type;
 
 typedef struct tcb tcbType;
-tcbType tcbs[NUMTHREADS];
+#define FIRSTSTATIC (1+DEFER)   /* threads in OSTHREADS come right after idle and the worker */
+#ifdef OSTHREADS
+/* --------------------------------------
+    Threads listed in OSTHREADS, see osconfig.h
+   --------------------------------------- */
+#define STATICWORDS(words) BLOCKS(((words) < MINSTACKSIZE) ? MINSTACKSIZE : (words))
+#define STATICPROTOTYPE(thread, words, pri) void thread(void);
+#define STATICID(thread, words, pri) STATIC_##thread,
+#define STATICCHECK(thread, words, pri) \
+  typedef char Priority_##thread[(((pri) < IDLEPRIORITY) && !(EDF && ((pri) == EDFPRIORITY))) ? 1 : -1];
+#define STATICSTACK(thread, words, pri) \
+  static uint64_t Stack_##thread[STATICWORDS(words)/2];  /* 8-byte aligned */
+#define STATICFUNCTION(thread, words, pri) &thread,
+#define STATICTCB(thread, words, pri) \
+  [FIRSTSTATIC+STATIC_##thread] = { \
+    .next = &tcbs[(FIRSTSTATIC+STATIC_##thread+1)%(FIRSTSTATIC+STATICTHREADS)], \
+    .priority = (pri), .basePriority = (pri), \
+    .stack = (int32_t *)Stack_##thread, .stackWords = STATICWORDS(words)},
+OSTHREADS(STATICPROTOTYPE)
+enum{ OSTHREADS(STATICID) STATICTHREADS };  /* index in OSTHREADS, and NUMSTATIC */
+OSTHREADS(STATICCHECK)
+OSTHREADS(STATICSTACK)
+static void(*const StaticThreads[NUMSTATIC])(void) = { OSTHREADS(STATICFUNCTION) };
+tcbType tcbs[NUMTHREADS+SYSTEMTHREADS] = { OSTHREADS(STATICTCB) };  // the last one links back to idle
+#else
+#define NUMSTATIC 0
+tcbType tcbs[NUMTHREADS+SYSTEMTHREADS];  // plus idle, and the worker and I2C driver if built
+#endif
 tcbType *RunPt;
-int32_t Stacks[NUMTHREADS][STACKSIZE];
-EventThread_type event_thread_array[NUMPERIODIC];
+uint32_t NumTcbs;                        // tcbs[0..NumTcbs-1] are in use
+int32_t StackPool[STACKPOOLSIZE];        // thread stacks, in STACKBLOCK word blocks
+uint32_t StackPoolUsed;                  // words handed out, stacks are never freed
+tcbType *ReadyList[NUMPRIORITIES];       // next thread to run at each priority
+uint32_t ReadyBits;                      // bit 31-p set if ReadyList[p] is not empty
+tcbType *SleepList;                      // sleeping threads, soonest to wake first
+#ifdef OSPERIODIC
+#define EVENTPROTOTYPE(thread, period) void thread(void);
+#define EVENTCHECK(thread, period) typedef char Period_##thread[((period) > 0) ? 1 : -1];
+#define STATICEVENT(thread, period) {&thread, (period), (period)},
+OSPERIODIC(EVENTPROTOTYPE)
+OSPERIODIC(EVENTCHECK)
+EventThread_type event_thread_array[NUMPERIODIC] = { OSPERIODIC(STATICEVENT) }; // made a heap by OS_Init
+uint32_t NumPeriodic = NUMSTATICEVENTS;
+#else
+EventThread_type event_thread_array[NUMPERIODIC]; // min-heap, soonest release at [0]
+uint32_t NumPeriodic;                    // event threads in event_thread_array
+#endif
+uint32_t OSTime;                         // msec since OS_Launch, wraps after 49 days
+uint32_t LastSwitch;                     // BSP_Time_Get when RunPt started running
+int InEventThread;                       // 1 while runperiodicevents runs an event thread
+#if TRACE
+struct{
+  struct TraceHeader Header;
+  struct TraceRecord Record[TRACESIZE];
+} Trace;
+#endif
+uint32_t TickMs = 1;                     // msec between runperiodicevents, more than 1 only when idle
+uint32_t SlicesOff;                      // 1 while SysTick is stopped because only idle can run
+uint32_t TickTime;                       // BSP_Time_Get at the last runperiodicevents
+tcbType *StackOverflowPt;                // thread whose canary was overwritten, the OS halted
+#if EDF
+uint32_t EDFUtil;                        // ppm of the CPU promised to EDF threads
+#endif
+
+void static idle(void);
+#if DEFER
+void static worker(void);
+#endif
+int static AddThread(void(*thread)(void), uint32_t stackWords, uint32_t priority, uint32_t deadline);
+static void ThreadStack(tcbType *pt, void(*thread)(void));
+static void ReadyAdd(tcbType *pt);
+static void ReadyRemove(tcbType *pt);
+#if TICKLESS
+static void TicksOn(void);
+#endif
+static void EventSiftDown(uint32_t i);
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -49,31 +153,316 @@ EventThread_type event_thread_array[NUMPERIODIC];
 // Inputs:  none
 // Outputs: none
 void OS_Init(void){
+#ifdef OSPERIODIC
+  uint32_t i;
+#endif
   DisableInterrupts();
   BSP_Clock_InitFastest();// set processor clock to fastest speed
   // perform any initializations needed
   BSP_Time_Init();
+#if TRACE
+  Trace.Header.Magic = TRACEMAGIC;
+  Trace.Header.Size = TRACESIZE;
+#endif
+  AddThread(&idle, MINSTACKSIZE, IDLEPRIORITY, 0);
+#if DEFER
+  AddThread(&worker, WORKERSTACKSIZE, WORKERPRIORITY, 0);
+#endif
+#ifdef OSTHREADS
+  for(NumTcbs=FIRSTSTATIC; NumTcbs<FIRSTSTATIC+NUMSTATIC; NumTcbs=NumTcbs+1){
+    ThreadStack(&tcbs[NumTcbs], StaticThreads[NumTcbs-FIRSTSTATIC]);
+    ReadyAdd(&tcbs[NumTcbs]);     // their TCBs and ring are already filled in
+  }
+#endif
+#ifdef OSPERIODIC
+  for(i=NumPeriodic/2; i>0; i=i-1){
+    EventSiftDown(i-1);           // listed in any order
+  }
+#endif
 }
 
-void SetInitialStack(int i){
-  tcbs[i].sp = &Stacks[i][STACKSIZE-16]; // thread stack pointer
-  Stacks[i][STACKSIZE-1]  = 0x01000000;   // thumb bit
-  Stacks[i][STACKSIZE-3]  = 0x14141414;   // R14
-  Stacks[i][STACKSIZE-4]  = 0x12121212;   // R12
-  Stacks[i][STACKSIZE-5]  = 0x03030303;   // R3
-  Stacks[i][STACKSIZE-6]  = 0x02020202;   // R2
-  Stacks[i][STACKSIZE-7]  = 0x01010101;   // R1
-  Stacks[i][STACKSIZE-8]  = 0x00000000;   // R0
-  Stacks[i][STACKSIZE-9]  = 0x11111111;   // R11
-  Stacks[i][STACKSIZE-10] = 0x10101010;  // R10
-  Stacks[i][STACKSIZE-11] = 0x09090909;  // R9
-  Stacks[i][STACKSIZE-12] = 0x08080808;  // R8
-  Stacks[i][STACKSIZE-13] = 0x07070707;  // R7
-  Stacks[i][STACKSIZE-14] = 0x06060606;  // R6
-  Stacks[i][STACKSIZE-15] = 0x05050505;  // R5
-  Stacks[i][STACKSIZE-16] = 0x04040404;  // R4
+#if TRACE
+// ******** TraceAdd ************
+// Record one event in the Trace ring, overwriting the oldest
+// Inputs:  event, event specific argument
+// Outputs: none
+static void TraceAdd(uint8_t event, uint16_t arg){
+  struct TraceRecord *r;
+  long status;
+  status = StartCritical();
+  r = &Trace.Record[Trace.Header.PutI&(TRACESIZE-1)];
+  r->Time = BSP_Time_Get();
+  r->Event = event;
+  r->Thread = (InEventThread || (RunPt == 0)) ? TRACE_NOTHREAD : (RunPt - tcbs);
+  r->Arg = arg;
+  Trace.Header.PutI++;
+  EndCritical(status);
+}
+#define TRACEADD(event, arg) TraceAdd(event, arg)
+#else
+#define TRACEADD(event, arg)
+#endif
+
+// ******** SetInitialStack ************
+// Build the frame that StartOS/SysTick_Handler pop to start a thread
+// Inputs:  thread, one past the highest word of its stack
+// Outputs: none
+void SetInitialStack(tcbType *pt, int32_t *top){
+  pt->sp = &top[-FRAMESIZE]; // thread stack pointer
+  top[-1]  = 0x01000000;  // thumb bit
+  top[-3]  = 0x14141414;  // R14
+  top[-4]  = 0x12121212;  // R12
+  top[-5]  = 0x03030303;  // R3
+  top[-6]  = 0x02020202;  // R2
+  top[-7]  = 0x01010101;  // R1
+  top[-8]  = 0x00000000;  // R0
+  top[-9]  = 0x11111111;  // R11
+  top[-10] = 0x10101010;  // R10
+  top[-11] = 0x09090909;  // R9
+  top[-12] = 0x08080808;  // R8
+  top[-13] = 0x07070707;  // R7
+  top[-14] = 0x06060606;  // R6
+  top[-15] = 0x05050505;  // R5
+  top[-16] = 0x04040404;  // R4
+  top[-17] = (int32_t)0xFFFFFFF9; // EXC_RETURN: thread mode, MSP, no FPU state
+  top[-18] = 0x00000000;  // padding, keeps 8-byte alignment
+}
+
+#if EDF
+// ******** EDFBefore ************
+// Whether a runs before b in the EDFPRIORITY ready list: threads only
+// lent EDFPRIORITY by a mutex first, then earliest due, wraparound safe
+// Inputs:  two threads at EDFPRIORITY
+// Outputs: 1 if a goes first, 0 if b does or they are equal
+static int EDFBefore(tcbType *a, tcbType *b){
+  if(b->deadline == 0){
+    return 0;
+  }
+  if(a->deadline == 0){
+    return 1;
+  }
+  return (int32_t)(a->due - b->due) < 0;
+}
+#endif
+
+// ******** ReadyAdd ************
+// Make a thread eligible to run, behind the others of its priority;
+// at EDFPRIORITY, in EDFBefore order.  An EDF thread that is not in
+// a job starts one, due deadline msec from now
+// Called with interrupts disabled
+// Inputs:  thread that is neither blocked nor sleeping
+// Outputs: none
+static void ReadyAdd(tcbType *pt){
+  tcbType *head = ReadyList[pt->priority];
+  tcbType *before = head;     /* pt goes just before this one */
+#if TICKLESS
+  if(SlicesOff){
+    TicksOn();                /* only idle could run, so ticks were stretched */
+  }
+#endif
+#if EDF
+  if(pt->deadline && !pt->released){
+    pt->released = 1;
+    pt->due = OSTime + pt->deadline;
+  }
+#endif
+  if(head == 0){
+    pt->nextReady = pt->prevReady = pt;
+    ReadyList[pt->priority] = pt;
+    ReadyBits |= 0x80000000>>pt->priority;
+  } else{                     /* insert at the tail, just before head, */
+#if EDF
+    if(pt->priority == EDFPRIORITY){  /* or before the first due later     */
+      while(!EDFBefore(pt, before) && (before->nextReady != head)){
+        before = before->nextReady;
+      }
+      if(!EDFBefore(pt, before)){
+        before = head;        /* after all of them */
+      }
+    }
+#endif
+    pt->nextReady = before;
+    pt->prevReady = before->prevReady;
+    before->prevReady->nextReady = pt;
+    before->prevReady = pt;
+#if EDF
+    if((before == head) && EDFBefore(pt, head) && (pt->priority == EDFPRIORITY)){
+      ReadyList[EDFPRIORITY] = pt;
+    }
+#endif
+  }
+  if(RunPt && ((pt->priority < RunPt->priority) ||
+     (EDF && (pt->priority == EDFPRIORITY) && (RunPt->priority == EDFPRIORITY) && (ReadyList[EDFPRIORITY] == pt)))){
+    INTCTRL = PENDSVSET;      /* preempt as soon as no ISR is active */
+  }
+}
+
+#if EDF
+// ******** JobDone ************
+// The running thread waits for its next input, which ends
+// the job of an EDF thread; count it if it is late
+// Called with interrupts disabled
+// Inputs:  none
+// Outputs: none
+static void JobDone(void){
+  if(RunPt->released){
+    RunPt->released = 0;
+    if((int32_t)(OSTime - RunPt->due) > 0){
+      RunPt->misses++;
+    }
+  }
+}
+
+// ******** JobNext ************
+// The running thread waited for input that was there already: for
+// an EDF thread that ends the job and releases the next one now, as
+// if it had blocked and been woken at once
+// Called with interrupts disabled, also before OS_Launch
+// Inputs:  none
+// Outputs: none
+static void JobNext(void){
+  if(RunPt && RunPt->deadline){
+    JobDone();
+    ReadyRemove(RunPt);
+    ReadyAdd(RunPt);            /* due deadline msec from now, behind those due sooner */
+    if((RunPt->priority == EDFPRIORITY) && (ReadyList[EDFPRIORITY] != RunPt)){
+      INTCTRL = PENDSVSET;
+    }
+  }
+}
+#else
+#define JobDone()
+#define JobNext()
+#endif
+
+// ******** ReadyRemove ************
+// Take a thread that is about to block or sleep out of the ready lists
+// Called with interrupts disabled
+// Inputs:  thread that is currently ready
+// Outputs: none
+static void ReadyRemove(tcbType *pt){
+  if(pt->nextReady == pt){    /* only one at this priority */
+    ReadyList[pt->priority] = 0;
+    ReadyBits &= ~(0x80000000>>pt->priority);
+  } else{
+    pt->prevReady->nextReady = pt->nextReady;
+    pt->nextReady->prevReady = pt->prevReady;
+    if(ReadyList[pt->priority] == pt){
+      ReadyList[pt->priority] = pt->nextReady;
+    }
+  }
+}
+
+// runs when every main thread is blocked or sleeping
+void static idle(void){
+  while(1){
+    WaitForInterrupt();
+  }
 }
 
+// ******** ThreadStack ************
+// Paint a thread's stack and build its first frame
+// Inputs:  thread with stack and stackWords set, thread function
+// Outputs: none
+static void ThreadStack(tcbType *pt, void(*thread)(void)){
+  int32_t *top = pt->stack + pt->stackWords;
+  uint32_t i;
+  for(i=0; i<pt->stackWords-FRAMESIZE; i=i+1){
+    pt->stack[i] = STACKPAINT;      // OS_StackHighWater finds the deepest overwritten word
+  }
+  SetInitialStack(pt, top); top[-2] = (int32_t)(thread); // PC
+}
+
+// ******** AddThread ************
+// Take a TCB and a stack from the pool and make the thread ready
+// Inputs:  thread function, stack size in words, priority,
+//          msec from release to due for an EDF thread or 0
+// Outputs: 1 if successful, 0 if out of TCBs or stack
+int static AddThread(void(*thread)(void), uint32_t stackWords, uint32_t priority, uint32_t deadline){
+  int32_t status;
+  tcbType *pt;
+  int32_t *top;
+  if(stackWords < MINSTACKSIZE){
+    stackWords = MINSTACKSIZE;
+  }
+  stackWords = BLOCKS(stackWords);  // whole blocks, keeps 8-byte alignment
+  status = StartCritical();
+  if((NumTcbs >= NUMTHREADS+SYSTEMTHREADS) || (StackPoolUsed+stackWords > STACKPOOLSIZE)){
+    EndCritical(status);
+    return 0;
+  }
+  pt = &tcbs[NumTcbs];
+  StackPoolUsed = StackPoolUsed + stackWords;
+  top = &StackPool[StackPoolUsed];  // stacks grow down from the end of their blocks
+  pt->stack = top - stackWords;
+  pt->stackWords = stackWords;
+  ThreadStack(pt, thread);
+  pt->blocked = 0;
+  pt->sleep = 0;
+  pt->priority = pt->basePriority = priority;
+  pt->mutexWait = pt->mutexHeld = 0;
+#if EDF
+  pt->deadline = deadline;
+  pt->released = 0;
+  pt->misses = 0;
+#endif
+  if(NumTcbs == 0){               // idle, always tcbs[0]
+    pt->next = NUMSTATIC ? &tcbs[FIRSTSTATIC] : pt;
+  } else{                         // ring searched by OS_Signal, order does not matter
+    pt->next = tcbs[0].next;
+    tcbs[0].next = pt;
+  }
+  NumTcbs = NumTcbs + 1;
+  ReadyAdd(pt);                   // in order, so equal priorities run in the order added
+  EndCritical(status);
+  return 1;
+}
+
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler
+// Inputs: function pointer to a void/void main thread
+//         stack size in 32-bit words, rounded up to the pool block size
+//         priority, 0 is highest, IDLEPRIORITY-1 is lowest
+// Outputs: 1 if successful, 0 if this thread can not be added
+// May be called before OS_Launch or by a running thread
+int OS_AddThread(void(*thread)(void), uint32_t stackWords, uint32_t priority){
+  if((priority >= IDLEPRIORITY) || (EDF && (priority == EDFPRIORITY))){
+    return 0;             // IDLEPRIORITY belongs to the idle thread
+  }
+  return AddThread(thread, stackWords, priority, 0);
+}
+
+#if EDF
+//******** OS_AddEDFThread ***************
+// Add one main thread at EDFPRIORITY, ordered by due time
+// Admission control: the sum over EDF threads of budget/min(period,deadline)
+// may not pass EDFMAXUTIL, which is enough for EDF to meet every deadline
+// as long as each job keeps to its budget
+// Inputs: function pointer to a void/void main thread, stack size in words,
+//         period and deadline in msec, budget in usec
+// Outputs: 1 if successful, 0 if refused or out of TCBs or stack
+// May be called before OS_Launch or by a running thread
+int OS_AddEDFThread(void(*thread)(void), uint32_t stackWords,
+                    uint32_t period, uint32_t deadline, uint32_t budget){
+  uint32_t util;
+  int ok = 0;
+  int32_t status;
+  if((deadline == 0) || (deadline > period)){
+    return 0;
+  }
+  util = (uint32_t)(((uint64_t)budget*1000 + deadline - 1)/deadline); // ppm, rounded up
+  status = StartCritical();
+  if((util <= EDFMAXUTIL) && (EDFUtil <= EDFMAXUTIL - util)){
+    ok = AddThread(thread, stackWords, EDFPRIORITY, deadline);
+    if(ok){
+      EDFUtil = EDFUtil + util;
+    }
+  }
+  EndCritical(status);
+  return ok;
+}
+#endif
+
 //******** OS_AddThreads ***************
 // Add six main threads to the scheduler
 // Inputs: function pointers to six void/void main threads
@@ -85,25 +474,57 @@ int OS_AddThreads(void(*thread0)(void),
                   void(*thread3)(void),
                   void(*thread4)(void),
                   void(*thread5)(void)){
-  // **similar to Lab 2. initialize as not blocked, not sleeping****
-  int32_t status;
-  status = StartCritical();
-  tcbs[0].next = &tcbs[1]; // 0 points to 1
-  tcbs[1].next = &tcbs[2]; // 1 points to 2 
-  tcbs[2].next = &tcbs[3]; // 2 points to 3
-  tcbs[3].next = &tcbs[4]; // 3 points to 4
-  tcbs[4].next = &tcbs[5]; // 4 points to 5
-  tcbs[5].next = &tcbs[0]; // 5 points to 0
-  SetInitialStack(0); Stacks[0][STACKSIZE-2] = (int32_t)(thread0); // PC
-  SetInitialStack(1); Stacks[1][STACKSIZE-2] = (int32_t)(thread1); // PC
-  SetInitialStack(2); Stacks[2][STACKSIZE-2] = (int32_t)(thread2); // PC
-  SetInitialStack(3); Stacks[3][STACKSIZE-2] = (int32_t)(thread3); // PC
-  SetInitialStack(4); Stacks[4][STACKSIZE-2] = (int32_t)(thread4); // PC
-  SetInitialStack(5); Stacks[5][STACKSIZE-2] = (int32_t)(thread5); // PC
-  RunPt = &tcbs[0];       // thread 0 will run first
-  EndCritical(status);
+  return OS_AddPriThreads(thread0, DEFAULTPRIORITY, thread1, DEFAULTPRIORITY,
+                          thread2, DEFAULTPRIORITY, thread3, DEFAULTPRIORITY,
+                          thread4, DEFAULTPRIORITY, thread5, DEFAULTPRIORITY);
+}
+
+//******** OS_AddPriThreads ***************
+// Add six main threads to the scheduler, each with a priority
+// Inputs: function pointers to six void/void main threads
+//         priorities, 0 is highest, IDLEPRIORITY-1 is lowest
+// Outputs: 1 if successful, 0 if this thread can not be added
+// This function will only be called once, after OS_Init and before OS_Launch
+int OS_AddPriThreads(void(*thread0)(void), uint32_t p0,
+                     void(*thread1)(void), uint32_t p1,
+                     void(*thread2)(void), uint32_t p2,
+                     void(*thread3)(void), uint32_t p3,
+                     void(*thread4)(void), uint32_t p4,
+                     void(*thread5)(void), uint32_t p5){
+  return OS_AddThread(thread0, STACKSIZE, p0) && OS_AddThread(thread1, STACKSIZE, p1) &&
+         OS_AddThread(thread2, STACKSIZE, p2) && OS_AddThread(thread3, STACKSIZE, p3) &&
+         OS_AddThread(thread4, STACKSIZE, p4) && OS_AddThread(thread5, STACKSIZE, p5);
+}
+
+// ******** EventBefore ************
+// Whether event_thread_array[i] is released before [j], wraparound safe
+static int EventBefore(uint32_t i, uint32_t j){
+	return (int32_t)(event_thread_array[i].release - event_thread_array[j].release) < 0;
+}
 
-  return 1;               // successful
+// ******** EventSwap ************
+static void EventSwap(uint32_t i, uint32_t j){
+	EventThread_type temp = event_thread_array[i];
+	event_thread_array[i] = event_thread_array[j];
+	event_thread_array[j] = temp;
+}
+
+// ******** EventSiftDown ************
+// Restore the heap after the release of event_thread_array[i] moved later
+// Inputs:  index whose release time increased
+// Outputs: none
+static void EventSiftDown(uint32_t i){
+	uint32_t child;
+	while( (child = 2*i+1) < NumPeriodic ){
+		if( (child+1 < NumPeriodic) && EventBefore(child+1, child) ){
+			child = child + 1;		/* the sooner of the two children */
+		}
+		if( !EventBefore(child, i) ){
+			return;
+		}
+		EventSwap(i, child);
+		i = child;
+	}
 }
 
 //******** OS_AddPeriodicEventThread ***************
@@ -116,47 +537,131 @@ int OS_AddThreads(void(*thread0)(void),
 // It is assumed the time to run these event threads is short compared to 1 msec
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
-// In Lab 3 this will be called exactly twice
+// Up to NUMPERIODIC event threads, first run one period from now
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period){
   int32_t status;
-  static int32_t next_thread_index = 0;	/* next event thread location to be populated */
+  uint32_t i;
+  if( (thread == 0) || (period == 0) ){
+	  return 0;
+  }
   status = StartCritical();
-
-  if( next_thread_index < NUMPERIODIC ){
-	  event_thread_array[next_thread_index].isr_ptr = thread;
-	  event_thread_array[next_thread_index].period = period;
-	  event_thread_array[next_thread_index].theTime = 0;	
-	  next_thread_index++;
+  if( NumPeriodic == NUMPERIODIC ){
+	  EndCritical(status);
+	  return 0;		/* full */
+  }
+  i = NumPeriodic;
+  NumPeriodic++;
+  event_thread_array[i].isr_ptr = thread;
+  event_thread_array[i].period = period;
+  event_thread_array[i].release = OSTime + period;
+  while( (i > 0) && EventBefore(i, (i-1)/2) ){	/* sift up */
+	  EventSwap(i, (i-1)/2);
+	  i = (i-1)/2;
   }
-  
   EndCritical(status);
   return 1;
+}
 
+#if TICKLESS
+// ******** IdleTickMs ************
+// Longest periodic interrupt interval that wakes no sleeper and
+// releases no event thread late.  Only divisors of 1000 are used,
+// so BSP_PeriodicTask_Init gets a whole number of Hz.
+// Inputs:  none
+// Outputs: msec until the next periodic interrupt should occur
+static uint32_t IdleTickMs(void){
+	static const uint16_t Divisors[] = {1000, 500, 250, 200, 125, 100, 50, 40, 25, 20, 10, 8, 5, 4, 2, 1};
+	uint32_t due = 1000;
+	int i = 0;
+	if( SleepList && ((uint32_t)SleepList->sleep < due) ){
+		due = SleepList->sleep;
+	}
+	if( NumPeriodic && ((event_thread_array[0].release - OSTime) < due) ){
+		due = event_thread_array[0].release - OSTime;
+	}
+	while( Divisors[i] > due ){
+		i++;
+	}
+	return Divisors[i];
 }
 
+void static runperiodicevents(void);
+
+// ******** TicksOn ************
+// Back to 1 msec periodic interrupts and time slices, when a thread
+// is made ready by other than runperiodicevents: OS_Signal,
+// OS_EventGroup_Set or OS_Defer from an ISR.  OSTime and the first
+// sleeper catch up on the whole msec since the last periodic
+// interrupt, fewer than TickMs, so no wakeup or release is missed
+// Called with interrupts disabled, while SlicesOff
+// Inputs:  none
+// Outputs: none
+static void TicksOn(void){
+	uint32_t ms = (BSP_Time_Get() - TickTime)/1000;
+	if( ms >= TickMs ){
+		ms = TickMs - 1;			/* that interrupt is pending, it adds TickMs */
+	}
+	OSTime += ms;
+	if( SleepList ){
+		SleepList->sleep -= ms;		/* still above 0, TickMs did not pass it */
+	}
+	SlicesOff = 0;
+	STCTRL = 0x00000007;			/* time slices again */
+	STCURRENT = 0;
+	TickMs = 1;
+	BSP_PeriodicTask_Init( &runperiodicevents, 1000, 3);	/* next one in 1 msec */
+}
+#endif
+
 void static runperiodicevents(void){
 // ****IMPLEMENT THIS****
 // **RUN PERIODIC THREADS, DECREMENT SLEEP COUNTERS
+// Every TickMs msec; TickMs never passes the next release or wakeup
 
-#if 1
-	/* Run every registered event thread */
-	for( int i=0; i < NUMPERIODIC; i++)
-	{
-		if(  event_thread_array[i].theTime == event_thread_array[i].period ) {
-			event_thread_array[i].isr_ptr();
-			event_thread_array[i].theTime = 0;
-		}
-		event_thread_array[i].theTime++;
+	/* Run only the event threads that are due, soonest first */
+	uint32_t ran = 0;
+	OSTime += TickMs;
+#if TICKLESS
+	TickTime = BSP_Time_Get();		/* OSTime is exact now, see TicksOn */
+#endif
+	InEventThread = 1;
+	while( NumPeriodic && ((int32_t)(OSTime - event_thread_array[0].release) >= 0) ){
+		event_thread_array[0].isr_ptr();
+		ran++;
+		event_thread_array[0].release += event_thread_array[0].period;	/* no drift */
+		EventSiftDown(0);
+	}
+	InEventThread = 0;
+	if( ran ){
+		TRACEADD(TRACE_PERIODIC, ran);
 	}
-#endif	
 	
-	/* Decrement Sleep Counters in Main Threads */
-	for( int i=0; i < NUMTHREADS; i++)
-	{
-		if( tcbs[i].sleep){
-			tcbs[i].sleep--;
+	/* Only the first sleeper counts down, the rest are relative to it */
+	if( SleepList ){
+		SleepList->sleep -= TickMs;
+		while( SleepList && (SleepList->sleep <= 0) ){
+			tcbType *pt = SleepList;
+			SleepList = pt->nextReady;
+			ReadyAdd(pt);				/* woke up */
 		}
 	}
+
+#if TICKLESS
+	/* Suppress ticks while only the idle thread can run: no time slices, */
+	/* and one periodic interrupt at the next release or wakeup           */
+	{	uint32_t idle = (ReadyBits == (0x80000000>>IDLEPRIORITY));
+		uint32_t tick = idle ? IdleTickMs() : 1;
+		if( idle != SlicesOff ){
+			SlicesOff = idle;
+			STCTRL = idle ? 0 : 0x00000007;	/* SysTick only when threads are ready */
+			STCURRENT = 0;
+		}
+		if( tick != TickMs ){
+			TickMs = tick;
+			BSP_PeriodicTask_Init( &runperiodicevents, 1000/tick, 3);	/* restarts at this tick */
+		}
+	}
+#endif
 }
 
 //******** OS_Launch ***************
@@ -167,19 +672,100 @@ void static runperiodicevents(void){
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xC0E00000; // SysTick priority 6, PendSV priority 7
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   BSP_PeriodicTask_Init( &runperiodicevents, 1000, 3);
+  Scheduler();                 // highest priority thread will run first
   StartOS();                   // start on the first task
 }
-// runs every ms
-void Scheduler(void){ // every time slice
-// ROUND ROBIN, skip blocked and sleeping threads
-	RunPt = RunPt->next;
-	while( (RunPt->blocked) || (RunPt->sleep) ){
-		RunPt = RunPt->next;
+// ******** SysTick_Handler ************
+// End of a time slice, the switch itself happens in PendSV_Handler
+// once every other ISR is done
+// Inputs:  none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = PENDSVSET;
+}
+
+// runs in PendSV_Handler, after a time slice, yield or wakeup
+void Scheduler(void){ // every thread switch
+// PRIORITY, round robin among the ready threads of the highest ready priority
+// blocked and sleeping threads are not in the ready lists, so this is O(1)
+	uint32_t priority = CLZ(ReadyBits);	/* idle thread keeps ReadyBits nonzero */
+	uint32_t now = BSP_Time_Get();
+	tcbType *old = RunPt;
+	if( old ){
+		old->runTime += now - LastSwitch;	/* ISRs count against the thread they interrupt */
 	}
+	LastSwitch = now;
+#if STACKCHECK
+	if( old && (old->stack[0] != STACKPAINT) ){	/* it went past the end of its stack, */
+		StackOverflowPt = old;			/* so whatever is below may be corrupt */
+		DisableInterrupts();
+		while(1){}				/* halt, look at StackOverflowPt */
+	}
+#endif
+	RunPt = ReadyList[priority];
+	if( !EDF || (priority != EDFPRIORITY) ){
+		ReadyList[priority] = RunPt->nextReady;	/* rotate, EDF stays in due order */
+	}
+	if( RunPt != old ){
+		TRACEADD(TRACE_SWITCH, priority);
+	}
+}
+
+//******** OS_Id ***************
+// Thread ID of the running thread
+// Inputs: none
+// Outputs: 2 for the first thread added, 3 for the second, ...,
+//          0 for idle, 1 for the deferred work worker
+//          (without DEFER the first thread added is 1); OS_I2C_Init
+//          adds the I2C driver, which takes the next ID
+uint32_t OS_Id(void){
+  return RunPt - tcbs;
+}
+
+//******** OS_RunTime ***************
+// CPU time used by a thread so far
+// Inputs: thread ID, see OS_Id
+// Outputs: usec, up to the last switch away from it; 0 if there is no such thread
+uint32_t OS_RunTime(uint32_t threadId){
+  if(threadId >= NumTcbs){
+    return 0;
+  }
+  return tcbs[threadId].runTime;
+}
+
+#if EDF
+//******** OS_DeadlineMisses ***************
+// Jobs of an EDF thread that were done after they were due
+// Inputs: thread ID, see OS_Id
+// Outputs: misses so far, 0 if there is no such thread
+uint32_t OS_DeadlineMisses(uint32_t threadId){
+  if(threadId >= NumTcbs){
+    return 0;
+  }
+  return tcbs[threadId].misses;
+}
+#endif
+
+//******** OS_StackHighWater ***************
+// Deepest the stack of a thread has been used so far
+// Inputs: thread ID, see OS_Id
+// Outputs: 32-bit words used, 0 if there is no such thread
+// Equal to the stack size means the canary is gone, see STACKCHECK
+uint32_t OS_StackHighWater(uint32_t threadId){
+  int32_t *pt;
+  uint32_t i = 0;
+  if(threadId >= NumTcbs){
+    return 0;
+  }
+  pt = tcbs[threadId].stack;
+  while((i < tcbs[threadId].stackWords) && (pt[i] == STACKPAINT)){
+    i = i + 1;
+  }
+  return tcbs[threadId].stackWords - i;
 }
 
 //******** OS_Suspend ***************
@@ -188,10 +774,51 @@ void Scheduler(void){ // every time slice
 // Outputs: none
 // Will be run again depending on sleep/block status
 void OS_Suspend(void){
-  STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
-// next thread gets a full time slice
+  INTCTRL = PENDSVSET;  // trigger PendSV, SysTick keeps its time base
+// next thread gets the rest of this time slice
+}
+
+// ******** SleepAdd ************
+// Insert a thread into the delta list SleepList
+// Called with interrupts disabled
+// Inputs:  thread that is no longer ready, msec to sleep (nonzero)
+// Outputs: none
+static void SleepAdd(tcbType *pt, int32_t sleepTime){
+	tcbType **prev = &SleepList;
+	while( *prev && ((*prev)->sleep <= sleepTime) ){	/* after those waking sooner or at the same time */
+		sleepTime = sleepTime - (*prev)->sleep;
+		prev = &(*prev)->nextReady;
+	}
+	pt->sleep = sleepTime;
+	pt->nextReady = *prev;
+	if( *prev ){
+		(*prev)->sleep = (*prev)->sleep - sleepTime;
+	}
+	*prev = pt;
+}
+
+#if I2CDRIVER
+// ******** SleepRemove ************
+// Take a thread out of the delta list SleepList before it is due
+// Called with interrupts disabled
+// Inputs:  thread
+// Outputs: 1 if it was sleeping, 0 if it was not in SleepList
+static int SleepRemove(tcbType *pt){
+	tcbType **prev = &SleepList;
+	while( *prev && (*prev != pt) ){
+		prev = &(*prev)->nextReady;
+	}
+	if( *prev == 0 ){
+		return 0;
+	}
+	*prev = pt->nextReady;
+	if( pt->nextReady ){
+		pt->nextReady->sleep = pt->nextReady->sleep + pt->sleep;	/* still relative to the one before */
+	}
+	pt->sleep = 0;
+	return 1;
 }
+#endif
 
 // ******** OS_Sleep ************
 // place this thread into a dormant state
@@ -201,17 +828,136 @@ void OS_Suspend(void){
 void OS_Sleep(uint32_t sleepTime){
 // set sleep parameter in TCB
 // suspend, stops running
-	RunPt->sleep = sleepTime;
+	DisableInterrupts();
+	TRACEADD(TRACE_SLEEP, (sleepTime > 0xFFFF) ? 0xFFFF : sleepTime);
+	if( sleepTime ){
+		JobDone();
+		ReadyRemove(RunPt);
+		SleepAdd(RunPt, sleepTime);
+	}
+	EnableInterrupts();
 	OS_Suspend();
 }
 
+// ******** SemaBlock ************
+// Append the running thread to a semaphore's wait queue
+// Called with interrupts disabled, after the count went negative
+// Inputs:  the count, and the head and tail of its wait queue
+// Outputs: none
+static void SemaBlock(int32_t *valuePt, tcbType **headPt, tcbType **tailPt){
+	JobDone();
+	RunPt->blocked = valuePt;	/* this semaphore is the reason this thread is blocked */
+	ReadyRemove(RunPt);
+	RunPt->nextReady = 0;		/* not ready, so nextReady links the wait queue */
+	if( *tailPt ){
+		(*tailPt)->nextReady = RunPt;
+	} else{
+		*headPt = RunPt;
+	}
+	*tailPt = RunPt;
+}
+
+// ******** SemaWakeup ************
+// Make the oldest thread in a semaphore's wait queue ready
+// Called with interrupts disabled, queue must not be empty
+// Inputs:  head and tail of the wait queue
+// Outputs: none
+static void SemaWakeup(tcbType **headPt, tcbType **tailPt){
+	tcbType *pt = *headPt;
+	*headPt = pt->nextReady;
+	if( *headPt == 0 ){
+		*tailPt = 0;
+	}
+	pt->blocked = 0;			/* wakeup this one */
+	ReadyAdd(pt);
+}
+
+// ******** OS_InitSema4 ************
+// Initialize counting semaphore with an empty wait queue
+// Inputs:  pointer to a semaphore
+//          initial value of semaphore
+// Outputs: none
+void OS_InitSema4(Sema4Type *semaPt, int32_t value){
+	semaPt->Value = value;
+	semaPt->Head = semaPt->Tail = 0;
+}
+
+// ******** OS_WaitSema4 ************
+// Decrement semaphore and block if less than zero
+// Inputs:  pointer to a counting semaphore
+// Outputs: none
+void OS_WaitSema4(Sema4Type *semaPt){
+	DisableInterrupts();
+	semaPt->Value = semaPt->Value - 1;
+	TRACEADD(TRACE_WAIT, semaPt->Value);
+	if( semaPt->Value < 0 ){
+		SemaBlock(&semaPt->Value, &semaPt->Head, &semaPt->Tail);
+		EnableInterrupts();
+		OS_Suspend();				/* run thread switcher */
+	} else{
+		JobNext();				/* did not block, the next job starts now */
+	}
+	EnableInterrupts();
+}
+
+// ******** OS_SignalSema4 ************
+// Increment semaphore, wakeup the longest waiting thread if any
+// Inputs:  pointer to a counting semaphore
+// Outputs: none
+void OS_SignalSema4(Sema4Type *semaPt){
+	long status;
+	status = StartCritical();		/* also called from event threads */
+	semaPt->Value = semaPt->Value + 1;
+	TRACEADD(TRACE_SIGNAL, semaPt->Value);
+	if( semaPt->Value <= 0 ){
+		SemaWakeup(&semaPt->Head, &semaPt->Tail);
+	}
+	EndCritical(status);
+}
+
+/* --------------------------------------
+    int32_t semaphores
+    A plain int32_t has no room for a wait queue, so its queue lives
+    in SemaQueues, hashed on the semaphore's address.  If the table is
+    full the semaphore falls back to the search of the TCB ring.
+   --------------------------------------- */
+struct semaqueue{
+  int32_t *key;              /* the semaphore, 0 if this slot is free */
+  tcbType *head;             /* longest waiting thread */
+  tcbType *tail;
+};
+struct semaqueue SemaQueues[NUMSEMAPHORES];
+
+// ******** SemaQueue ************
+// Find the wait queue of an int32_t semaphore, claiming one if new
+// Inputs:  pointer to a counting semaphore
+// Outputs: its wait queue, 0 if SemaQueues is full
+static struct semaqueue *SemaQueue(int32_t *semaPt){
+	uint32_t i = ((uint32_t)(uintptr_t)semaPt>>2)&(NUMSEMAPHORES-1);
+	for( int n=0; n < NUMSEMAPHORES; n++){
+		if( SemaQueues[i].key == semaPt ){
+			return &SemaQueues[i];
+		}
+		if( SemaQueues[i].key == 0 ){
+			SemaQueues[i].key = semaPt;
+			return &SemaQueues[i];
+		}
+		i = (i+1)&(NUMSEMAPHORES-1);
+	}
+	return 0;
+}
+
 // ******** OS_InitSemaphore ************
 // Initialize counting semaphore
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
 void OS_InitSemaphore(int32_t *semaPt, int32_t value){
+	long status;
+	status = StartCritical();
 	*semaPt = value;
+	SemaQueue(semaPt);				/* claim its wait queue now, not in OS_Wait */
+	EndCritical(status);
 }
 
 // ******** OS_Wait ************
@@ -221,12 +967,23 @@ void OS_InitSemaphore(int32_t *semaPt, int32_t value){
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Wait(int32_t *semaPt){
+	struct semaqueue *q;
 	DisableInterrupts();
 	(*semaPt) = (*semaPt) - 1;
+	TRACEADD(TRACE_WAIT, *semaPt);
 	if( (*semaPt) < 0 ) {
-			RunPt->blocked = semaPt;	/* this semaphore is the reason this thread is blocked */
+			q = SemaQueue(semaPt);
+			if( q ){
+				SemaBlock(semaPt, &q->head, &q->tail);
+			} else{
+				JobDone();
+				RunPt->blocked = semaPt;	/* OS_Signal will search the TCBs */
+				ReadyRemove(RunPt);
+			}
 			EnableInterrupts();			
 			OS_Suspend();				/* run thread switcher */
+	} else{
+		JobNext();				/* did not block, the next job starts now */
 	}
 	EnableInterrupts();
 }
@@ -238,25 +995,561 @@ void OS_Wait(int32_t *semaPt){
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
 void OS_Signal(int32_t *semaPt){
+	struct semaqueue *q;
 	tcbType *pt;
 	DisableInterrupts();
 	(*semaPt) = (*semaPt) + 1;
+	TRACEADD(TRACE_SIGNAL, *semaPt);
 	if( (*semaPt) <= 0 ){
-		pt = RunPt->next; 			/* search for a thread blocked on this semaphore */
-		while( pt->blocked != semaPt){
-			pt = pt->next;
+		q = SemaQueue(semaPt);
+		if( q ){
+			SemaWakeup(&q->head, &q->tail);
+		} else{
+			pt = RunPt->next; 			/* search for a thread blocked on this semaphore */
+			while( pt->blocked != semaPt){
+				pt = pt->next;
+			}
+			pt->blocked = 0;			/* wakeup this one */
+			ReadyAdd(pt);
 		}
-		pt->blocked = 0;			/* wakeup this one */
 	}
 	EnableInterrupts();
 }
 
-#define FSIZE 10    // can be any size
-uint32_t PutI;      // index of where to put next
-uint32_t GetI;      // index of where to get next
+// ******** IsReady ************
+// Whether a thread is in the ready lists
+// Called with interrupts disabled
+// Inputs:  thread
+// Outputs: 1 if ready, 0 if blocked or sleeping
+static int IsReady(tcbType *pt){
+	tcbType *sleeper;
+	if( pt->blocked ){
+		return 0;
+	}
+	for(sleeper = SleepList; sleeper; sleeper = sleeper->nextReady){
+		if( sleeper == pt ){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// ******** SetPriority ************
+// Change the priority a thread runs at, moving it between ready lists
+// Called with interrupts disabled
+// Inputs:  thread, new priority
+// Outputs: none
+static void SetPriority(tcbType *pt, uint32_t priority){
+	if( pt->priority == priority ){
+		return;
+	}
+	if( IsReady(pt) ){
+		ReadyRemove(pt);
+		pt->priority = priority;
+		ReadyAdd(pt);
+	} else{
+		pt->priority = priority;	/* takes effect when it is made ready */
+	}
+}
+
+// ******** MutexWaitAdd ************
+// Put a thread in the wait queue of a mutex,
+// highest priority first, FIFO among equals
+// Called with interrupts disabled
+// Inputs:  mutex, thread blocked on it
+// Outputs: none
+static void MutexWaitAdd(MutexType *mutexPt, tcbType *pt){
+	tcbType **prev = &mutexPt->Head;
+	while( *prev && ((*prev)->priority <= pt->priority) ){
+		prev = &(*prev)->nextReady;
+	}
+	pt->nextReady = *prev;
+	*prev = pt;
+}
+
+// ******** OS_Mutex_Init ************
+// Initialize a mutex, free and with no waiting threads
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_Mutex_Init(MutexType *mutexPt){
+	mutexPt->Owner = 0;
+	mutexPt->Head = 0;
+	mutexPt->Next = 0;
+}
+
+// ******** OS_Mutex_Lock ************
+// Take a mutex, block until it is free
+// While blocked, the owner (and whatever it is blocked on in turn)
+// runs at no lower a priority than this thread
+// Inputs:  pointer to a mutex, not already owned by this thread
+// Outputs: none
+void OS_Mutex_Lock(MutexType *mutexPt){
+	tcbType *pt, **prev;
+	MutexType *waits;
+	DisableInterrupts();
+	if( mutexPt->Owner == 0 ){
+		mutexPt->Owner = RunPt;		/* free, take it */
+		mutexPt->Next = RunPt->mutexHeld;
+		RunPt->mutexHeld = mutexPt;
+		EnableInterrupts();
+		return;
+	}
+	RunPt->blocked = (int32_t *)mutexPt;
+	RunPt->mutexWait = mutexPt;
+	ReadyRemove(RunPt);
+	MutexWaitAdd(mutexPt, RunPt);
+	pt = mutexPt->Owner;			/* priority inheritance, along the chain of owners */
+	while( pt && (pt->priority > RunPt->priority) ){
+		SetPriority(pt, RunPt->priority);
+		waits = pt->mutexWait;
+		if( waits == 0 ){
+			break;
+		}
+		for(prev = &waits->Head; *prev != pt; prev = &(*prev)->nextReady){}
+		*prev = pt->nextReady;		/* an owner that waits moves up its own queue too */
+		MutexWaitAdd(waits, pt);
+		pt = waits->Owner;
+	}
+	EnableInterrupts();
+	OS_Suspend();				/* OS_Mutex_Unlock hands over ownership */
+}
+
+// ******** OS_Mutex_Unlock ************
+// Give up a mutex, to the highest priority waiting thread if any
+// Drops back to the priority this thread had before it inherited one,
+// and lets the new owner run now if it has a higher priority
+// Inputs:  pointer to a mutex owned by this thread
+// Outputs: none
+void OS_Mutex_Unlock(MutexType *mutexPt){
+	MutexType **held, *m;
+	tcbType *pt;
+	uint32_t priority;
+	int preempt = 0;
+	DisableInterrupts();
+	for(held = &RunPt->mutexHeld; *held != mutexPt; held = &(*held)->Next){}
+	*held = mutexPt->Next;
+	priority = RunPt->basePriority;		/* still inherit from the mutexes kept */
+	for(m = RunPt->mutexHeld; m; m = m->Next){
+		if( m->Head && (m->Head->priority < priority) ){
+			priority = m->Head->priority;
+		}
+	}
+	SetPriority(RunPt, priority);
+	pt = mutexPt->Head;
+	if( pt ){
+		mutexPt->Head = pt->nextReady;
+		mutexPt->Owner = pt;
+		mutexPt->Next = pt->mutexHeld;
+		pt->mutexHeld = mutexPt;
+		pt->mutexWait = 0;
+		pt->blocked = 0;
+		if( mutexPt->Head && (mutexPt->Head->priority < pt->priority) ){
+			pt->priority = mutexPt->Head->priority;
+		}
+		ReadyAdd(pt);
+		preempt = (pt->priority < RunPt->priority);
+	} else{
+		mutexPt->Owner = 0;
+	}
+	EnableInterrupts();
+	if( preempt ){
+		OS_Suspend();
+	}
+}
+
+#if EVENTGROUPS
+// ******** OS_EventGroup_Init ************
+// Initialize an event group, all flags clear and no waiting threads
+// Inputs:  pointer to an event group
+// Outputs: none
+void OS_EventGroup_Init(EventGroupType *groupPt){
+	groupPt->Bits = 0;
+	groupPt->Head = 0;
+}
+
+// ******** OS_EventGroup_Set ************
+// Set flags, then wake the waiting threads that are satisfied,
+// oldest first; each consumes its flags before the next is checked
+// May be called from event threads, ISRs and main threads
+// Inputs:  pointer to an event group, flags to set
+// Outputs: none
+void OS_EventGroup_Set(EventGroupType *groupPt, uint32_t bits){
+	tcbType **prev, *pt;
+	uint32_t got;
+	long status;
+	status = StartCritical();
+	groupPt->Bits |= bits;
+	TRACEADD(TRACE_SIGNAL, groupPt->Bits);
+	prev = &groupPt->Head;
+	while( (pt = *prev) ){
+		got = groupPt->Bits & pt->waitBits;
+		if( pt->waitAll ? (got == pt->waitBits) : (got != 0) ){
+			*prev = pt->nextReady;		/* out of the wait list before ReadyAdd relinks it */
+			groupPt->Bits &= ~got;
+			pt->waitBits = got;			/* what OS_EventGroup_Wait returns */
+			pt->blocked = 0;
+			ReadyAdd(pt);
+		} else{
+			prev = &pt->nextReady;
+		}
+	}
+	EndCritical(status);
+}
+
+// ******** OS_EventGroup_Clear ************
+// Clear flags without waiting for them
+// Inputs:  pointer to an event group, flags to clear
+// Outputs: the flags that were set, now cleared
+uint32_t OS_EventGroup_Clear(EventGroupType *groupPt, uint32_t bits){
+	uint32_t got;
+	long status;
+	status = StartCritical();
+	got = groupPt->Bits & bits;
+	groupPt->Bits &= ~bits;
+	EndCritical(status);
+	return got;
+}
+
+// ******** OS_EventGroup_Wait ************
+// Take the wanted flags that are set if that satisfies the wait,
+// otherwise join the end of the wait list until OS_EventGroup_Set
+// hands them over
+// Inputs:  pointer to an event group, flags wanted (nonzero), all
+// Outputs: the wanted flags that were set, now cleared
+uint32_t OS_EventGroup_Wait(EventGroupType *groupPt, uint32_t bits, uint32_t all){
+	tcbType **prev;
+	uint32_t got;
+	DisableInterrupts();
+	got = groupPt->Bits & bits;
+	TRACEADD(TRACE_WAIT, bits);
+	if( all ? (got == bits) : (got != 0) ){
+		groupPt->Bits &= ~got;
+		JobNext();				/* did not block, the next job starts now */
+		EnableInterrupts();
+		return got;
+	}
+	JobDone();
+	RunPt->blocked = (int32_t *)groupPt;
+	RunPt->waitBits = bits;
+	RunPt->waitAll = all;
+	ReadyRemove(RunPt);
+	RunPt->nextReady = 0;
+	for(prev = &groupPt->Head; *prev; prev = &(*prev)->nextReady){}
+	*prev = RunPt;
+	EnableInterrupts();
+	OS_Suspend();				/* OS_EventGroup_Set wakes this thread */
+	return RunPt->waitBits;
+}
+#endif
+
+// ******** OS_Ring_Init ************
+// Initialize an empty single producer, single consumer ring
+// Inputs:  ring, storage for it, number of entries (a power of 2)
+// Outputs: 0 if successful, -1 if size is not a power of 2
+int OS_Ring_Init(RingType *ring, uint32_t *buffer, uint32_t size){
+	if( (size == 0) || (size&(size-1)) ){
+		return -1;
+	}
+	ring->Data = buffer;
+	ring->Mask = size - 1;
+	ring->PutI = ring->GetI = 0;	/* Empty */
+	ring->Waiter = 0;
+	ring->LostData = 0;
+	return 0;
+}
+
+// ******** RingWake ************
+// Make the consumer blocked on an empty ring ready, after a put
+// Inputs:  ring
+// Outputs: none
+static void RingWake(RingType *ring){
+	tcbType *pt;
+	int32_t status;
+	if( ring->Waiter ){
+		status = StartCritical();
+		pt = ring->Waiter;
+		if( pt ){
+			ring->Waiter = 0;
+			pt->blocked = 0;
+			ReadyAdd(pt);			/* consumer runs at its next turn */
+		}
+		EndCritical(status);
+	}
+}
+
+// ******** RingWait ************
+// Block the running thread until a ring is not empty
+// Inputs:  ring
+// Outputs: none
+static void RingWait(RingType *ring){
+	if( ring->PutI == ring->GetI ){
+		DisableInterrupts();
+		while( ring->PutI == ring->GetI ){	/* check again, a put may have slipped in */
+			JobDone();
+			ring->Waiter = RunPt;
+			RunPt->blocked = (int32_t *)&ring->Waiter;
+			ReadyRemove(RunPt);
+			EnableInterrupts();
+			OS_Suspend();
+			DisableInterrupts();
+		}
+		EnableInterrupts();
+	}
+#if EDF
+	else if( RunPt && RunPt->deadline ){	/* did not block, the next job starts now */
+		DisableInterrupts();
+		JobNext();
+		EnableInterrupts();
+	}
+#endif
+}
+
+// ******** OS_Ring_Put ************
+// Put an entry in a ring, do not block or spin if full
+// Only the producer writes PutI and only the consumer writes GetI,
+// so no critical section unless the consumer is blocked
+// Inputs:  ring, data to be stored
+// Outputs: 0 if successful, -1 if the ring is full
+int OS_Ring_Put(RingType *ring, uint32_t data){
+	if( (ring->PutI - ring->GetI) > ring->Mask ){
+		ring->LostData++;
+		return -1;	/* ring FULL */
+	}
+	ring->Data[ring->PutI&ring->Mask] = data;	/* store data before the index that */
+	ring->PutI = ring->PutI + 1;			/* publishes it, both are volatile   */
+	RingWake(ring);
+	return 0;   							/* success  */
+}
+
+// ******** OS_Ring_Get ************
+// Get an entry from a ring, block if empty
+// Inputs:  ring
+// Outputs: data retrieved
+uint32_t OS_Ring_Get(RingType *ring){
+	uint32_t data;
+	RingWait(ring);
+	data = ring->Data[ring->GetI&ring->Mask];	/* read data before freeing the slot */
+	ring->GetI = ring->GetI + 1;
+	return data;
+}
+
+#if DEFER
+struct work{
+  void (*function)(uint32_t);
+  uint32_t arg;
+};
+struct work WorkQueue[NUMWORK];
+uint32_t WorkPutI;          // entries ever posted
+uint32_t WorkGetI;          // entries ever run
+Sema4Type WorkCount;        // entries waiting for the worker
+uint32_t WorkLost;          // OS_Defer calls dropped because the queue was full
+
+// ******** OS_Defer ************
+// Run a function later in thread context, from the worker thread
+// Event threads post the slow part of their work here and return
+// Inputs:  function to call and the argument to pass it
+// Outputs: 1 if queued, 0 if the queue is full
+int OS_Defer(void(*function)(uint32_t), uint32_t arg){
+	long status;
+	status = StartCritical();		/* any number of event and main threads post */
+	if( (WorkPutI - WorkGetI) == NUMWORK ){
+		WorkLost++;
+		EndCritical(status);
+		return 0;
+	}
+	WorkQueue[WorkPutI&(NUMWORK-1)].function = function;
+	WorkQueue[WorkPutI&(NUMWORK-1)].arg = arg;
+	WorkPutI++;
+	OS_SignalSema4(&WorkCount);
+	EndCritical(status);
+	return 1;
+}
+
+// runs deferred work in the order posted, at WORKERPRIORITY
+void static worker(void){
+	struct work w;
+	while(1){
+		OS_WaitSema4(&WorkCount);
+		w = WorkQueue[WorkGetI&(NUMWORK-1)];
+		WorkGetI++;				/* slot free before the work runs */
+		w.function(w.arg);
+	}
+}
+#endif
+
+#if I2CDRIVER
+I2CRequestType *I2CQueue;   // submitted, not yet started, in order
+I2CRequestType *I2CBusy;    // started, waiting for End to return 1
+tcbType *I2CDriver;         // the driver thread, once OS_I2C_Init has run
+
+// ******** OS_I2C_Submit ************
+// Append a transaction to I2CQueue, and wake the driver if it sleeps
+// Inputs:  request with Start, End, Result and Delay filled in,
+//          not already queued
+// Outputs: none
+void OS_I2C_Submit(I2CRequestType *request){
+	I2CRequestType **prev;
+	long status;
+	OS_InitSema4(&request->Done, 0);
+	request->Next = 0;
+	status = StartCritical();
+	for(prev = &I2CQueue; *prev; prev = &(*prev)->Next){}
+	*prev = request;
+	if( I2CDriver && SleepRemove(I2CDriver) ){
+		ReadyAdd(I2CDriver);		/* start it now, not when its sleep ends */
+	}
+	EndCritical(status);
+}
+
+// ******** OS_I2C_Wait ************
+// Block until a submitted transaction is done
+// Inputs:  request given to OS_I2C_Submit
+// Outputs: none
+void OS_I2C_Wait(I2CRequestType *request){
+	OS_WaitSema4(&request->Done);
+}
+
+// starts queued transactions, then finishes each one once its End says
+// so; sleeps until the soonest is due or OS_I2C_Submit wakes it
+void static i2cdriver(void){
+	I2CRequestType *request, **prev;
+	uint32_t sleep, now;
+	while(1){
+		DisableInterrupts();
+		request = I2CQueue;			/* take everything submitted so far */
+		I2CQueue = 0;
+		EnableInterrupts();
+		while( request ){
+			I2CRequestType *next = request->Next;
+			request->Start();
+			request->Due = OSTime + request->Delay;
+			request->Next = I2CBusy;
+			I2CBusy = request;
+			request = next;
+		}
+		sleep = I2CIDLEMS;
+		now = OSTime;				/* one time for the whole pass, OSTime may tick during it */
+		prev = &I2CBusy;
+		while( (request = *prev) ){
+			if( ((int32_t)(now - request->Due) >= 0) && request->End(request->Result) ){
+				*prev = request->Next;
+				OS_SignalSema4(&request->Done);
+				continue;
+			}
+			if( (int32_t)(now - request->Due) >= 0 ){
+				request->Due = now + 1;	/* not ready yet, poll again next msec */
+			}
+			if( request->Due - now < sleep ){
+				sleep = request->Due - now;
+			}
+			prev = &request->Next;
+		}
+		if( sleep == 0 ){
+			sleep = 1;				/* SleepAdd needs a nonzero time */
+		}
+		DisableInterrupts();
+		if( I2CQueue == 0 ){			/* a submit after this finds it in SleepList */
+			ReadyRemove(RunPt);
+			SleepAdd(RunPt, sleep);
+		}
+		EnableInterrupts();
+		OS_Suspend();
+	}
+}
+
+// ******** OS_I2C_Init ************
+// Add the I2C driver thread at I2CPRIORITY, with the next thread ID
+// Inputs:  none
+// Outputs: 1 if successful, 0 if out of TCBs or stack
+int OS_I2C_Init(void){
+	if( AddThread(&i2cdriver, I2CSTACKSIZE, I2CPRIORITY, 0) == 0 ){
+		return 0;
+	}
+	I2CDriver = &tcbs[NumTcbs-1];
+	return 1;
+}
+#endif
+
+#if FIFOCREATE
+RingType FifoRings[NUMFIFOS];
+uint32_t NumFifoRings;
+uint32_t FifoPool[FIFOPOOLSIZE];
+uint32_t FifoPoolUsed;      // words handed out, FIFOs are never deleted
+
+// ******** OS_FIFO_Create ************
+// Make another FIFO, in addition to the one used by OS_FIFO_Put/Get
+// Inputs:  number of entries, rounded up to a power of 2
+// Outputs: handle for the OS_FIFO_*N and OS_Ring_* functions,
+//          0 if out of FIFOs or storage, or capacity is over FIFOPOOLSIZE
+RingType *OS_FIFO_Create(uint32_t capacity){
+	RingType *fifo = 0;
+	uint32_t size = 1;
+	int32_t status;
+	if( capacity > FIFOPOOLSIZE ){
+		return 0;				/* would never fit, and doubling size could overflow */
+	}
+	while( size < capacity ){
+		size = size*2;
+	}
+	status = StartCritical();
+	if( (NumFifoRings < NUMFIFOS) && (size <= FIFOPOOLSIZE-FifoPoolUsed) ){
+		fifo = &FifoRings[NumFifoRings];
+		OS_Ring_Init(fifo, &FifoPool[FifoPoolUsed], size);
+		NumFifoRings = NumFifoRings + 1;
+		FifoPoolUsed = FifoPoolUsed + size;
+	}
+	EndCritical(status);
+	return fifo;
+}
+
+// ******** OS_FIFO_PutN ************
+// Put up to n entries in a FIFO, with one index update and one wakeup
+// Exactly one thread or event thread puts,
+// do not block or spin if full
+// Inputs:  FIFO, data to be stored, number of entries
+// Outputs: number stored, the rest are counted in LostData
+uint32_t OS_FIFO_PutN(RingType *fifo, const uint32_t *data, uint32_t n){
+	uint32_t putI = fifo->PutI;
+	uint32_t room = fifo->Mask + 1 - (putI - fifo->GetI);
+	uint32_t i;
+	if( n > room ){
+		fifo->LostData += n - room;
+		n = room;
+	}
+	for(i=0; i<n; i=i+1){
+		fifo->Data[(putI+i)&fifo->Mask] = data[i];
+	}
+	fifo->PutI = putI + n;			/* publish all of them at once */
+	if( n ){
+		RingWake(fifo);
+	}
+	return n;
+}
+
+// ******** OS_FIFO_GetN ************
+// Get every entry available in a FIFO, up to max
+// Exactly one main thread gets,
+// do block if empty
+// Inputs:  FIFO, where to store the data, most entries to get (at least 1)
+// Outputs: number retrieved, at least 1
+uint32_t OS_FIFO_GetN(RingType *fifo, uint32_t *data, uint32_t max){
+	uint32_t getI, n, i;
+	RingWait(fifo);
+	getI = fifo->GetI;
+	n = fifo->PutI - getI;
+	if( n > max ){
+		n = max;
+	}
+	for(i=0; i<n; i=i+1){
+		data[i] = fifo->Data[(getI+i)&fifo->Mask];
+	}
+	fifo->GetI = getI + n;			/* free all of them at once */
+	return n;
+}
+#endif
+
 uint32_t Fifo[FSIZE];
-int32_t  CurrentSize;// 0 means FIFO empty, FSIZE means full
-uint32_t LostData;  // number of lost pieces of data
+RingType FifoRing;
 
 // ******** OS_FIFO_Init ************
 // Initialize FIFO.  
@@ -264,9 +1557,7 @@ uint32_t LostData;  // number of lost pieces of data
 // Inputs:  none
 // Outputs: none
 void OS_FIFO_Init(void){
-	PutI = GetI = 0;	/* Empty */
-	OS_InitSemaphore(&CurrentSize, 0);
-	LostData = 0;
+	OS_Ring_Init(&FifoRing, Fifo, FSIZE);
 }
 
 // ******** OS_FIFO_Put ************
@@ -276,16 +1567,7 @@ void OS_FIFO_Init(void){
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data){
-  if( CurrentSize == FSIZE ){
-	  LostData++;
-	  return -1;	/* FIFO FULL */
-  }
-  else {
-	  Fifo[PutI] = data; 				/* put data in Fifo */
-	  PutI = (PutI + 1) % FSIZE;		/* place to put next data */
-	  OS_Signal(&CurrentSize);
-  }
-  return 0;   							/* success  */
+	return OS_Ring_Put(&FifoRing, data);
 }
 
 // ******** OS_FIFO_Get ************
@@ -295,13 +1577,206 @@ int OS_FIFO_Put(uint32_t data){
 // Inputs:  none
 // Outputs: data retrieved
 uint32_t OS_FIFO_Get(void){
-	uint32_t data;
-	
-	OS_Wait(&CurrentSize);				/* Block if empty */
-	data = Fifo[GetI];
-	GetI = (GetI + 1) % FSIZE;		/* place to get next */
-	return data;
+	return OS_Ring_Get(&FifoRing);
+}
+
+#if POOLS
+// ******** OS_PoolCreate ************
+// Carve storage into numBlocks blocks of blockWords words each,
+// and link every block onto the free list through its first word
+// Inputs:  pool, storage of at least blockWords*numBlocks words,
+//          words per block (room for a pointer), number of blocks
+// Outputs: 0 if successful, -1 if a block can not hold the link
+int OS_PoolCreate(PoolType *pool, uint32_t *buffer, uint32_t blockWords, uint32_t numBlocks){
+	uint32_t i;
+	if( blockWords*sizeof(uint32_t) < sizeof(uint32_t *) ){
+		return -1;
+	}
+	pool->Free = 0;
+	for(i=numBlocks; i>0; i=i-1){		/* link last to first, so blocks go out in address order */
+		uint32_t *block = &buffer[(i-1)*blockWords];
+		*(uint32_t **)block = pool->Free;
+		pool->Free = block;
+	}
+	pool->Base = buffer;
+	pool->BlockWords = blockWords;
+	pool->NumBlocks = numBlocks;
+	pool->NumFree = numBlocks;
+	pool->MinFree = numBlocks;
+	pool->Failed = 0;
+	OS_InitSema4(&pool->Available, numBlocks);
+	return 0;
+}
+
+// ******** PoolTake ************
+// Take the first block off the free list, which is not empty
+// Called with interrupts disabled
+// Inputs:  pool
+// Outputs: pointer to a block
+static uint32_t *PoolTake(PoolType *pool){
+	uint32_t *block = pool->Free;
+	pool->Free = *(uint32_t **)block;
+	pool->NumFree--;
+	if( pool->NumFree < pool->MinFree ){
+		pool->MinFree = pool->NumFree;
+	}
+	return block;
+}
+
+// ******** OS_PoolAlloc ************
+// Take the first block off the free list, unless every free
+// block is promised to a thread woken in OS_PoolAllocWait
+// May be called from event threads and main threads
+// Inputs:  pool
+// Outputs: pointer to a block, 0 if the pool is empty
+void *OS_PoolAlloc(PoolType *pool){
+	uint32_t *block = 0;
+	long status;
+	status = StartCritical();		/* any number of event and main threads share a pool */
+	if( pool->Available.Value > 0 ){	/* so nobody waits on it either */
+		pool->Available.Value--;
+		block = PoolTake(pool);
+	}else{
+		pool->Failed++;
+	}
+	EndCritical(status);
+	return block;
+}
+
+// ******** OS_PoolAllocWait ************
+// Wait for a block on the Available semaphore, then take it
+// Only main threads may call it
+// Inputs:  pool
+// Outputs: pointer to a block
+void *OS_PoolAllocWait(PoolType *pool){
+	uint32_t *block;
+	long status;
+	OS_WaitSema4(&pool->Available);		/* a block is kept for this thread */
+	status = StartCritical();
+	block = PoolTake(pool);
+	EndCritical(status);
+	return block;
+}
+
+// ******** OS_PoolFree ************
+// Push a block back on the free list, and wake a thread
+// waiting in OS_PoolAllocWait if there is one
+// May be called from event threads and main threads
+// Inputs:  pool, block returned by OS_PoolAlloc or OS_PoolAllocWait on that pool
+// Outputs: 0 if successful, -1 if block is not one of the pool's blocks,
+//          or if every block is free already (a double free); a double
+//          free while other blocks are out is not detected
+int OS_PoolFree(PoolType *pool, void *block){
+	uintptr_t offset = (uintptr_t)block - (uintptr_t)pool->Base;	/* wraps if below Base */
+	long status;
+	if( (offset >= (uintptr_t)pool->NumBlocks*pool->BlockWords*sizeof(uint32_t)) ||
+	    (offset%(pool->BlockWords*sizeof(uint32_t)) != 0) ){
+		return -1;				/* outside the pool, or inside a block */
+	}
+	status = StartCritical();
+	if( pool->NumFree == pool->NumBlocks ){
+		EndCritical(status);
+		return -1;				/* none is out, so this one was freed twice */
+	}
+	*(uint32_t **)block = pool->Free;
+	pool->Free = block;
+	pool->NumFree++;
+	OS_SignalSema4(&pool->Available);
+	EndCritical(status);
+	return 0;
+}
+
+#endif
+
+#if MAILBOX
+// ******** OS_Mailbox_Init ************
+// Initialize an empty mailbox over three blocks of storage
+// Inputs:  mailbox, storage of 3*blockWords words, words per block
+// Outputs: first block for the producer to fill
+void *OS_Mailbox_Init(MailboxType *box, uint32_t *buffer, uint32_t blockWords){
+	box->Fill = &buffer[0];
+	box->Ready = &buffer[blockWords];
+	box->Read = &buffer[2*blockWords];
+	OS_InitSema4(&box->Full, 0);
+	box->LostBlocks = 0;
+	return box->Fill;
 }
 
+// ******** OS_Mailbox_Post ************
+// Swap the filled block with the ready one, so the newest data is
+// ready and the producer gets the spare (or an unreceived older block)
+// Exactly one thread or event thread posts, do not block
+// Inputs:  mailbox
+// Outputs: next block for the producer to fill
+void *OS_Mailbox_Post(MailboxType *box){
+	uint32_t *block;
+	long status;
+	status = StartCritical();
+	block = box->Ready;
+	box->Ready = box->Fill;
+	box->Fill = block;
+	if( box->Full.Value > 0 ){
+		box->LostBlocks++;			/* consumer never saw the block now being refilled */
+	}else{
+		OS_SignalSema4(&box->Full);
+	}
+	EndCritical(status);
+	return block;
+}
+
+// ******** OS_Mailbox_Receive ************
+// Wait for a posted block, then swap it with the one the caller
+// received last time, which becomes the spare
+// Exactly one main thread receives, do block if nothing new
+// Inputs:  mailbox
+// Outputs: block, owned by the caller until its next receive
+void *OS_Mailbox_Receive(MailboxType *box){
+	uint32_t *block;
+	long status;
+	OS_WaitSema4(&box->Full);
+	status = StartCritical();
+	if( box->Full.Value > 0 ){		/* posted again after the wait returned */
+		box->Full.Value--;			/* no waiters, so just take it too */
+		box->LostBlocks++;
+	}
+	block = box->Ready;
+	box->Ready = box->Read;
+	box->Read = block;
+	EndCritical(status);
+	return block;
+}
 
+// ******** OS_Mailbox_Accept ************
+// OS_Mailbox_Receive without the wait: swap only if a block is ready
+// Exactly one main thread receives, do not block
+// Inputs:  mailbox
+// Outputs: block, owned by the caller until its next receive or
+//          accept; 0 if nothing new has been posted
+void *OS_Mailbox_Accept(MailboxType *box){
+	uint32_t *block = 0;
+	long status;
+	status = StartCritical();
+	if( box->Full.Value > 0 ){		/* the only receiver is running, so no waiters */
+		box->Full.Value = 0;
+		block = box->Ready;
+		box->Ready = box->Read;
+		box->Read = block;
+	}
+	EndCritical(status);
+	return block;
+}
+
+#endif
 
+// ******** OS_Trace ************
+// Where the kernel keeps its trace of scheduling events
+// Inputs:  none
+// Outputs: trace header, followed in memory by Size records;
+//          0 if the kernel was built without TRACE
+const struct TraceHeader *OS_Trace(void){
+#if TRACE
+	return &Trace.Header;
+#else
+	return 0;
+#endif
+}
@@ -37,8 +37,43 @@
 // Outputs: none
 void OS_Init(void);
 
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler
+// The highest priority thread that is not blocked or sleeping runs,
+// threads of equal priority share the processor round robin
+// Inputs: function pointer to a void/void main thread
+//         stack size in 32-bit words, rounded up to a multiple of STACKBLOCK;
+//         interrupts also run on this stack, so at least MINSTACKSIZE is used;
+//         a thread that uses the FPU needs about 50 more for its registers
+//         priority, 0 is highest, IDLEPRIORITY-1 is lowest, EDFPRIORITY is
+//         kept for OS_AddEDFThread (settings in osconfig.h)
+// Outputs: 1 if successful, 0 if out of threads or stack space
+// May be called after OS_Init, before OS_Launch or by a running thread
+int OS_AddThread(void(*thread)(void), uint32_t stackWords, uint32_t priority);
+
+//******** OS_AddEDFThread ***************
+// Add one main thread scheduled earliest deadline first
+// EDF threads all run at EDFPRIORITY (see osconfig.h), and among
+// themselves the one with the earliest deadline runs.  Each time the
+// thread is made ready (signalled, given FIFO data, woken from sleep)
+// a job is released, due deadline msec later; the job is done when
+// the thread next waits on a semaphore, event group or FIFO or sleeps.
+// A wait that does not block also ends the job and releases the next
+// one at once.  Waiting on a mutex is part of the job.  A job done
+// after it was due is a miss.
+// Inputs: function pointer to a void/void main thread
+//         stack size in 32-bit words, see OS_AddThread
+//         period, fewest msec between releases
+//         deadline, msec from release to done, at most period
+//         budget, usec of CPU each job needs at most
+// Outputs: 1 if successful, 0 if out of threads or stack space, or if
+//          the budgets of all EDF threads would need over EDFMAXUTIL ppm of the CPU
+// May be called after OS_Init, before OS_Launch or by a running thread
+int OS_AddEDFThread(void(*thread)(void), uint32_t stackWords,
+                    uint32_t period, uint32_t deadline, uint32_t budget);
+
 //******** OS_AddThreads ***************
-// Add six main threads to the scheduler
+// Add six main threads to the scheduler, all with the same priority
 // Inputs: function pointers to six void/void main threads
 // Outputs: 1 if successful, 0 if this thread can not be added
 // This function will only be called once, after OS_Init and before OS_Launch
@@ -49,6 +84,20 @@ int OS_AddThreads(void(*thread0)(void),
                   void(*thread4)(void),
                   void(*thread5)(void));
 
+//******** OS_AddPriThreads ***************
+// Add six main threads to the scheduler, each with a priority
+// and a STACKSIZE-word stack, see OS_AddThread
+// Inputs: function pointers to six void/void main threads
+//         priorities, 0 is highest, IDLEPRIORITY-1 is lowest
+// Outputs: 1 if successful, 0 if this thread can not be added
+// This function will only be called once, after OS_Init and before OS_Launch
+int OS_AddPriThreads(void(*thread0)(void), uint32_t p0,
+                     void(*thread1)(void), uint32_t p1,
+                     void(*thread2)(void), uint32_t p2,
+                     void(*thread3)(void), uint32_t p3,
+                     void(*thread4)(void), uint32_t p4,
+                     void(*thread5)(void), uint32_t p5);
+
 //******** OS_AddPeriodicEventThread ***************
 // Add one background periodic event thread
 // Typically this function receives the highest priority
@@ -59,7 +108,7 @@ int OS_AddThreads(void(*thread0)(void),
 // It is assumed the time to run these event threads is short compared to 1 msec
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
-// In Lab 3 this will be called exactly twice
+// Fails if NUMPERIODIC event threads exist already or period is 0
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
 
 //******** OS_Launch ***************
@@ -69,8 +118,38 @@ int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
 // Errors: theTimeSlice must be less than 16,777,216
 void OS_Launch(uint32_t theTimeSlice);
 
+//******** OS_Id ***************
+// Thread ID of the running thread
+// Inputs: none
+// Outputs: 2 for the first thread added, 3 for the second, ...,
+//          0 for idle, 1 for the deferred work worker; the I2C driver
+//          counts as a thread added when OS_I2C_Init is called
+uint32_t OS_Id(void);
+
+//******** OS_RunTime ***************
+// CPU time used by a thread so far, counted at each thread switch;
+// interrupt time is charged to the thread that was interrupted
+// Inputs: thread ID, see OS_Id
+// Outputs: usec, 0 if there is no such thread
+uint32_t OS_RunTime(uint32_t threadId);
+
+//******** OS_DeadlineMisses ***************
+// Jobs of an EDF thread that were done after they were due
+// Inputs: thread ID, see OS_Id
+// Outputs: misses so far, 0 if there is no such EDF thread
+uint32_t OS_DeadlineMisses(uint32_t threadId);
+
+//******** OS_StackHighWater ***************
+// Deepest the stack of a thread has been used so far
+// Unused stack is painted when the thread is added; if a thread uses
+// all of it, the OS halts when it next switches away from the thread
+// Inputs: thread ID, see OS_Id
+// Outputs: 32-bit words used, 0 if there is no such thread
+uint32_t OS_StackHighWater(uint32_t threadId);
+
 //******** OS_Suspend ***************
 // Called by main thread to cooperatively suspend operation
+// The next thread runs for the rest of the current time slice
 // Inputs: none
 // Outputs: none
 // Will be run again depending on sleep/block status
@@ -106,6 +185,191 @@ void OS_Wait(int32_t *semaPt);
 // Outputs: none
 void OS_Signal(int32_t *semaPt);
 
+// ******** Sema4Type ************
+// Counting semaphore that keeps its own FIFO queue of blocked threads,
+// so wait and signal take constant time and wake threads in order.
+// The int32_t API above works as before; Sema4Type avoids the lookup
+// of an int32_t semaphore's wait queue.
+struct tcb;
+struct Sema4{
+  int32_t     Value;  // >= 0 is units available, < 0 is -(number blocked)
+  struct tcb *Head;   // longest waiting thread, woken first
+  struct tcb *Tail;   // most recent to block
+};
+typedef struct Sema4 Sema4Type;
+
+// ******** OS_InitSema4 ************
+// Initialize counting semaphore with an empty wait queue
+// Inputs:  pointer to a semaphore
+//          initial value of semaphore
+// Outputs: none
+void OS_InitSema4(Sema4Type *semaPt, int32_t value);
+
+// ******** OS_WaitSema4 ************
+// Decrement semaphore and block if less than zero
+// Inputs:  pointer to a counting semaphore
+// Outputs: none
+void OS_WaitSema4(Sema4Type *semaPt);
+
+// ******** OS_SignalSema4 ************
+// Increment semaphore, wakeup the longest waiting thread if any
+// May be called from event threads
+// Inputs:  pointer to a counting semaphore
+// Outputs: none
+void OS_SignalSema4(Sema4Type *semaPt);
+
+// ******** MutexType ************
+// Lock owned by one thread at a time, with priority inheritance:
+// a thread blocked on a mutex lends its priority to the owner, so a
+// lower priority owner can not be held off by medium priority threads.
+// Only main threads may lock and unlock, and only the owner may unlock.
+struct Mutex{
+  struct tcb   *Owner;  // thread holding the mutex, or null if free
+  struct tcb   *Head;   // waiting threads, highest priority first
+  struct Mutex *Next;   // next mutex held by the same owner
+};
+typedef struct Mutex MutexType;
+
+// ******** OS_Mutex_Init ************
+// Initialize a mutex, free and with no waiting threads
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_Mutex_Init(MutexType *mutexPt);
+
+// ******** OS_Mutex_Lock ************
+// Take a mutex, block until it is free
+// Inputs:  pointer to a mutex, not already owned by this thread
+// Outputs: none
+void OS_Mutex_Lock(MutexType *mutexPt);
+
+// ******** OS_Mutex_Unlock ************
+// Give up a mutex, to the highest priority waiting thread if any
+// Inputs:  pointer to a mutex owned by this thread
+// Outputs: none
+void OS_Mutex_Unlock(MutexType *mutexPt);
+
+// ******** EventGroupType ************
+// Up to 32 event flags.  Event threads, ISRs and main threads set
+// flags; a main thread blocks until any, or all, of the flags it
+// names are set, so one thread can serve several sources with one
+// wakeup.  Waiting consumes the flags that satisfied the wait.
+struct EventGroup{
+  uint32_t volatile Bits; // flags set and not yet consumed
+  struct tcb *Head;       // waiting threads, in the order they began to wait
+};
+typedef struct EventGroup EventGroupType;
+
+// ******** OS_EventGroup_Init ************
+// Initialize an event group, all flags clear and no waiting threads
+// Inputs:  pointer to an event group
+// Outputs: none
+void OS_EventGroup_Init(EventGroupType *groupPt);
+
+// ******** OS_EventGroup_Set ************
+// Set flags, waking every waiting thread that is then satisfied
+// May be called from event threads, ISRs and main threads
+// Inputs:  pointer to an event group, flags to set
+// Outputs: none
+void OS_EventGroup_Set(EventGroupType *groupPt, uint32_t bits);
+
+// ******** OS_EventGroup_Clear ************
+// Clear flags without waiting for them, e.g. to take what else is
+// new after waiting for the one flag that paces the thread
+// Inputs:  pointer to an event group, flags to clear
+// Outputs: the flags that were set, now cleared
+uint32_t OS_EventGroup_Clear(EventGroupType *groupPt, uint32_t bits);
+
+// ******** OS_EventGroup_Wait ************
+// Block until any (all = 0) or all (all = 1) of some flags are set,
+// then clear the ones that were wanted and set.
+// Only main threads may wait
+// Inputs:  pointer to an event group, flags wanted (nonzero), all
+// Outputs: the wanted flags that were set, now cleared
+uint32_t OS_EventGroup_Wait(EventGroupType *groupPt, uint32_t bits, uint32_t all);
+
+// ******** RingType ************
+// Single producer, single consumer FIFO of 32-bit entries.
+// Put and get only load and store the free-running indices,
+// so neither touches the TCBs unless the consumer had to block.
+struct Ring{
+  uint32_t volatile *Data;     // Mask+1 entries
+  uint32_t Mask;               // size-1, size is a power of 2
+  uint32_t volatile PutI;      // entries ever put, written only by the producer
+  uint32_t volatile GetI;      // entries ever got, written only by the consumer
+  struct tcb *volatile Waiter; // consumer blocked on an empty ring, or null
+  uint32_t LostData;           // puts dropped because the ring was full
+};
+typedef struct Ring RingType;
+
+// ******** OS_Ring_Init ************
+// Initialize an empty single producer, single consumer ring
+// Inputs:  ring, storage for it, number of entries (a power of 2)
+// Outputs: 0 if successful, -1 if size is not a power of 2
+int OS_Ring_Init(RingType *ring, uint32_t *buffer, uint32_t size);
+
+// ******** OS_Ring_Put ************
+// Put an entry in a ring.
+// Exactly one thread or event thread puts,
+// do not block or spin if full
+// Inputs:  ring, data to be stored
+// Outputs: 0 if successful, -1 if the ring is full
+int OS_Ring_Put(RingType *ring, uint32_t data);
+
+// ******** OS_Ring_Get ************
+// Get an entry from a ring.
+// Exactly one main thread gets,
+// do block if empty
+// Inputs:  ring
+// Outputs: data retrieved
+uint32_t OS_Ring_Get(RingType *ring);
+
+// ******** OS_Defer ************
+// Run a function later in thread context.
+// Event threads post their slow work here and return; a kernel
+// worker thread, above every other main thread, runs it in order
+// May be called from event threads and main threads
+// Inputs:  function to call and the argument to pass it
+// Outputs: 1 if queued, 0 if the queue (NUMWORK entries) is full
+int OS_Defer(void(*function)(uint32_t), uint32_t arg);
+
+// ******** I2CRequestType ************
+// One sensor transaction for the I2C driver thread: Start begins it,
+// and End is called Delay msec later, then every msec until it
+// returns 1.  Only the driver thread calls Start and End, so the bus
+// needs no mutex, and conversions of different sensors overlap.
+struct I2CRequest{
+  void (*Start)(void);        // begin the transaction, e.g. BSP_TempSensor_Start
+  int (*End)(void *result);   // finish it into result, 1 if done, 0 if not yet
+  void *Result;               // passed to End
+  uint32_t Delay;             // msec from Start to the first End
+  uint32_t Due;               // set by the kernel
+  Sema4Type Done;             // set by the kernel
+  struct I2CRequest *Next;    // set by the kernel
+};
+typedef struct I2CRequest I2CRequestType;
+
+// ******** OS_I2C_Init ************
+// Add the I2C driver thread, which runs at I2CPRIORITY (osconfig.h)
+// Call once, after OS_Init and before OS_Launch; it takes the next
+// thread ID, as OS_AddThread would
+// Inputs:  none
+// Outputs: 1 if successful, 0 if out of threads or stack space
+int OS_I2C_Init(void);
+
+// ******** OS_I2C_Submit ************
+// Queue a transaction for the driver thread, do not wait for it
+// Inputs:  request with Start, End, Result and Delay filled in,
+//          not already queued
+// Outputs: none
+void OS_I2C_Submit(I2CRequestType *request);
+
+// ******** OS_I2C_Wait ************
+// Block until a submitted transaction is done
+// Only the thread that submitted it may wait
+// Inputs:  request given to OS_I2C_Submit
+// Outputs: none
+void OS_I2C_Wait(I2CRequestType *request);
+
 // ******** OS_FIFO_Init ************
 // Initialize FIFO. 
 // One event thread producer, one main thread consumer
@@ -129,4 +393,157 @@ int OS_FIFO_Put(uint32_t data);
 // Outputs: data retrieved
 uint32_t OS_FIFO_Get(void);
 
+// ******** OS_FIFO_Create ************
+// Make another FIFO, in addition to the one used by OS_FIFO_Put/Get
+// Use OS_Ring_Put/OS_Ring_Get for single entries
+// Inputs:  number of entries, rounded up to a power of 2
+// Outputs: handle for the FIFO, 0 if out of FIFOs or storage
+//          (FIFOPOOLSIZE words in all, see osconfig.h)
+RingType *OS_FIFO_Create(uint32_t capacity);
+
+// ******** OS_FIFO_PutN ************
+// Put up to n entries in a FIFO.
+// Exactly one thread or event thread puts,
+// do not block or spin if full
+// Inputs:  FIFO, data to be stored, number of entries
+// Outputs: number stored, entries that did not fit are lost
+uint32_t OS_FIFO_PutN(RingType *fifo, const uint32_t *data, uint32_t n);
+
+// ******** OS_FIFO_GetN ************
+// Get every entry available in a FIFO, up to max.
+// Exactly one main thread gets,
+// do block if empty
+// Inputs:  FIFO, where to store the data, most entries to get (at least 1)
+// Outputs: number retrieved, at least 1
+uint32_t OS_FIFO_GetN(RingType *fifo, uint32_t *data, uint32_t max);
+
+// ******** PoolType ************
+// Fixed-size block allocator.  Free blocks are linked through
+// their first word, so allocating and freeing are O(1); a pool of
+// message buffers or sample blocks can be recycled instead of each
+// one living in RAM forever.
+struct Pool{
+  uint32_t *Free;       // first free block, or null if none
+  uint32_t *Base;       // first block, the pool's blocks follow it
+  uint32_t BlockWords;  // size of each block in 32-bit words
+  uint32_t NumBlocks;   // blocks in the pool
+  uint32_t NumFree;     // blocks on the free list
+  uint32_t MinFree;     // fewest free blocks ever, for sizing the pool
+  uint32_t Failed;      // OS_PoolAlloc calls that found the pool empty
+  Sema4Type Available;  // free blocks not promised to a waiting thread
+};
+typedef struct Pool PoolType;
+
+// ******** OS_PoolCreate ************
+// Carve storage into numBlocks blocks of blockWords words each
+// Inputs:  pool, storage of at least blockWords*numBlocks words,
+//          words per block (room for a pointer), number of blocks
+// Outputs: 0 if successful, -1 if a block can not hold the link
+int OS_PoolCreate(PoolType *pool, uint32_t *buffer, uint32_t blockWords, uint32_t numBlocks);
+
+// ******** OS_PoolAlloc ************
+// Take a block from a pool.
+// May be called from event threads and main threads,
+// do not block or spin if empty
+// Inputs:  pool
+// Outputs: pointer to a block, 0 if the pool is empty
+void *OS_PoolAlloc(PoolType *pool);
+
+// ******** OS_PoolAllocWait ************
+// Take a block from a pool.
+// Only main threads may call it,
+// do block if empty, until OS_PoolFree gives a block back
+// Inputs:  pool
+// Outputs: pointer to a block
+void *OS_PoolAllocWait(PoolType *pool);
+
+// ******** OS_PoolFree ************
+// Give a block back to the pool it came from.
+// May be called from event threads and main threads
+// Inputs:  pool, block returned by OS_PoolAlloc or OS_PoolAllocWait on that pool
+// Outputs: 0 if successful, -1 if block is not one of the pool's blocks,
+//          or if no block is out; other double frees are not detected
+int OS_PoolFree(PoolType *pool, void *block);
+
+// ******** MailboxType ************
+// Triple-buffered mailbox that hands whole blocks from one producer
+// (event thread or main thread) to one consumer main thread by
+// swapping pointers.  The producer always owns a block to fill, the
+// consumer owns the block it last received until it asks for the
+// next, and the third block holds the newest posted data, so neither
+// side copies, waits on the other, or sees a half-written block.
+struct Mailbox{
+  uint32_t *Fill;       // block the producer is filling
+  uint32_t *Ready;      // newest posted block, or the spare
+  uint32_t *Read;       // block the consumer is reading
+  Sema4Type Full;       // 1 while Ready holds a block not yet received
+  uint32_t LostBlocks;  // posted blocks replaced before they were received
+};
+typedef struct Mailbox MailboxType;
+
+// ******** OS_Mailbox_Init ************
+// Initialize an empty mailbox over three blocks of storage
+// Inputs:  mailbox, storage of 3*blockWords words, words per block
+// Outputs: first block for the producer to fill
+void *OS_Mailbox_Init(MailboxType *box, uint32_t *buffer, uint32_t blockWords);
+
+// ******** OS_Mailbox_Post ************
+// Publish the block the producer has filled.
+// Exactly one thread or event thread posts,
+// do not block; an unreceived older block is replaced
+// Inputs:  mailbox
+// Outputs: next block for the producer to fill
+void *OS_Mailbox_Post(MailboxType *box);
+
+// ******** OS_Mailbox_Receive ************
+// Take the newest posted block, giving back the one received before.
+// Exactly one main thread receives,
+// do block if nothing new has been posted
+// Inputs:  mailbox
+// Outputs: block, owned by the caller until its next receive
+void *OS_Mailbox_Receive(MailboxType *box);
+
+// ******** OS_Mailbox_Accept ************
+// Take the newest posted block if there is one, as OS_Mailbox_Receive.
+// Exactly one main thread receives,
+// do not block
+// Inputs:  mailbox
+// Outputs: block, owned by the caller until its next receive or
+//          accept; 0 if nothing new has been posted
+void *OS_Mailbox_Accept(MailboxType *box);
+
+// ******** Trace ************
+// The kernel records scheduling events in a ring of TraceRecords.
+// Dump it from the debugger (the header then Size records) or with
+// lab3host on the host, and print it with host/tracedecode.
+#define TRACEMAGIC 0x31435254   // "TRC1"
+enum traceevent{
+  TRACE_SWITCH = 1,    // Thread switched in, Arg is its priority
+  TRACE_WAIT,          // Thread called OS_Wait/OS_WaitSema4, Arg is the new value,
+                       // or OS_EventGroup_Wait, Arg is the flags wanted
+  TRACE_SIGNAL,        // OS_Signal/OS_SignalSema4, Arg is the new value,
+                       // or OS_EventGroup_Set, Arg is the flags now set
+  TRACE_SLEEP,         // Thread called OS_Sleep, Arg is msec
+  TRACE_PERIODIC       // event threads ran, Arg is how many, Thread was interrupted
+};
+#define TRACE_NOTHREAD 0xFF     // Thread of records made by event threads
+struct TraceRecord{
+  uint32_t Time;       // BSP_Time_Get, usec
+  uint8_t  Event;      // enum traceevent
+  uint8_t  Thread;     // OS_Id of the running thread, or TRACE_NOTHREAD
+  uint16_t Arg;        // see enum traceevent
+};
+struct TraceHeader{
+  uint32_t Magic;      // TRACEMAGIC
+  uint32_t Size;       // records in the ring, a power of 2
+  uint32_t PutI;       // records ever written, the oldest kept is PutI-Size
+};
+
+// ******** OS_Trace ************
+// Where the kernel keeps its trace of scheduling events
+// Inputs:  none
+// Outputs: trace header, followed in memory by Size records;
+//          0 if the kernel was built without TRACE
+const struct TraceHeader *OS_Trace(void);
+
 #endif
@@ -14,24 +14,44 @@
 
         EXTERN  RunPt            ; currently running thread
         EXPORT  StartOS
-        EXPORT  SysTick_Handler
+        EXPORT  PendSV_Handler
         IMPORT  Scheduler
 
 
-SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
+; Stack of a thread that is not running, from its saved SP up:
+;   R0 (padding), EXC_RETURN, R4-R11,
+;   S16-S31                    only if EXC_RETURN bit 4 is clear,
+;   R0-R3,R12,LR,PC,PSR        exception frame built by the core,
+;   S0-S15,FPSCR,reserved      also only if EXC_RETURN bit 4 is clear
+; A thread that has used the FPU has CONTROL.FPCA set, so the core
+; reserves room for S0-S15 and saves them lazily, on the first FPU
+; instruction after the exception: here, the VPUSH.  Threads that
+; never touch the FPU pay for neither.
+; PendSV has the lowest priority, so it only ever interrupts a thread;
+; SysTick_Handler (os.c), OS_Suspend and wakeups pend it.
+PendSV_Handler                 ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10          ;    EXC_RETURN bit 4 clear: thread used the FPU
+    IT      EQ
+    VPUSHEQ {S16-S31}          ;    save the FPU regs the core does not
+    ENDIF
     PUSH    {R4-R11}           ; 3) Save remaining regs r4-11
+    PUSH    {R0,LR}            ;    and EXC_RETURN, R0 keeps SP 8-byte aligned
     LDR     R0, =RunPt         ; 4) R0=pointer to RunPt, old thread
     LDR     R1, [R0]           ;    R1 = RunPt
     STR     SP, [R1]           ; 5) Save SP into TCB
-;    LDR     R1, [R1,#4]       ; 6) R1 = RunPt->next
-;    STR     R1, [R0]          ;    RunPt = R1
-    PUSH    {R0,LR}
     BL      Scheduler
-    POP     {R0,LR}
+    LDR     R0, =RunPt
     LDR     R1, [R0]           ; 6) R1 = RunPt, new thread
     LDR     SP, [R1]           ; 7) new thread SP; SP = RunPt->sp;
+    POP     {R0,LR}            ;    LR = EXC_RETURN of the new thread
     POP     {R4-R11}           ; 8) restore regs r4-11
+    IF {TARGET_FPU_VFP}
+    TST     LR, #0x10
+    IT      EQ
+    VPOPEQ  {S16-S31}
+    ENDIF
     CPSIE   I                  ; 9) tasks run with interrupts enabled
     BX      LR                 ; 10) restore R0-R3,R12,LR,PC,PSR
 
@@ -39,6 +59,7 @@ StartOS
     LDR     R0, =RunPt         ; currently running thread
     LDR     R2, [R0]           ; R2 = value of RunPt
     LDR     SP, [R2]           ; new thread SP; SP = RunPt->stackPointer;
+    ADD     SP,SP,#8           ; discard padding and EXC_RETURN, no FPU state yet
     POP     {R4-R11}           ; restore regs r4-11
     POP     {R0-R3}            ; restore regs r0-3
     POP     {R12}
@@ -0,0 +1,157 @@
+// osconfig.h
+// Runs on LM4F120/TM4C123/MSP432
+// Compile-time configuration of the Lab 3 kernel, read by os.c and
+// the host kernel tests only.
+// Every setting may be overridden on the compiler command line, for
+// example -DNUMTHREADS=8 or -DI2CDRIVER=0.  The TCB table, stack pool,
+// periodic event heap and FIFO storage are sized from these settings,
+// and a subsystem set to 0 leaves both its code and its RAM out of the
+// build; calling one of its OS_ functions is then a link error.
+
+#ifndef __OSCONFIG_H
+#define __OSCONFIG_H  1
+
+// ---------- subsystems, 1 builds it, 0 leaves it out ----------
+#ifndef DEFER
+#define DEFER       1        // OS_Defer and the worker thread that runs the work
+#endif
+#ifndef EDF
+#define EDF         1        // OS_AddEDFThread, OS_DeadlineMisses, EDFPRIORITY
+#endif
+#ifndef EVENTGROUPS
+#define EVENTGROUPS 1        // OS_EventGroup_*
+#endif
+#ifndef I2CDRIVER
+#define I2CDRIVER   1        // OS_I2C_* and the I2C driver thread
+#endif
+#ifndef FIFOCREATE
+#define FIFOCREATE  1        // OS_FIFO_Create, OS_FIFO_PutN and OS_FIFO_GetN
+#endif
+#ifndef POOLS
+#define POOLS       1        // OS_PoolCreate, OS_PoolAlloc and OS_PoolFree
+#endif
+#ifndef MAILBOX
+#define MAILBOX     1        // OS_Mailbox_*
+#endif
+#ifndef TICKLESS
+#define TICKLESS    1        // stretch the periodic interrupt while only idle can run
+#endif
+#ifndef STACKCHECK
+#define STACKCHECK  1        // halt if the thread switched out overwrote its stack canary
+#endif
+#ifndef TRACE
+#define TRACE       1        // record scheduling events in Trace
+#endif
+
+// ---------- sizes ----------
+#ifndef NUMTHREADS
+#define NUMTHREADS  6        // maximum number of threads, not counting idle, worker and I2C driver
+#endif
+#ifndef NUMPERIODIC
+#define NUMPERIODIC 8        // maximum number of periodic threads
+#endif
+#ifndef STACKSIZE
+#define STACKSIZE   100      // number of 32-bit words in stack per OS_AddThreads thread
+#endif
+#ifndef THREADSTACKWORDS     // words for every stack but the system threads', smaller stacks may
+#define THREADSTACKWORDS (NUMTHREADS*STACKWORDS) // lower it once OS_StackHighWater is measured on the board
+#endif
+#ifndef WORKERSTACKSIZE
+#define WORKERSTACKSIZE 128  // deferred work runs on the worker's stack
+#endif
+#ifndef I2CSTACKSIZE
+#define I2CSTACKSIZE 64      // the I2C driver only calls BSP Start/End functions
+#endif
+#ifndef NUMWORK
+#define NUMWORK     16       // deferred work queue entries, a power of 2
+#endif
+#ifndef NUMSEMAPHORES
+#define NUMSEMAPHORES 16     // int32_t semaphores with a wait queue, a power of 2
+#endif
+#ifndef FSIZE
+#define FSIZE       16       // entries in the OS_FIFO_Put/Get FIFO, a power of 2
+#endif
+#ifndef NUMFIFOS
+#define NUMFIFOS    4        // FIFOs OS_FIFO_Create can make
+#endif
+#ifndef FIFOPOOLSIZE
+#define FIFOPOOLSIZE 256     // words of storage shared by those FIFOs
+#endif
+#ifndef TRACESIZE
+#define TRACESIZE   256      // trace records kept, a power of 2
+#endif
+
+// ---------- priorities, 0 is highest ----------
+#define NUMPRIORITIES 32     // one bit per priority in ReadyBits
+#define IDLEPRIORITY  (NUMPRIORITIES-1)  // reserved for the idle thread
+#ifndef DEFAULTPRIORITY
+#define DEFAULTPRIORITY 15   // used by OS_AddThreads, all threads equal
+#endif
+#ifndef WORKERPRIORITY
+#define WORKERPRIORITY 0     // deferred work runs before any other main thread
+#endif
+#ifndef I2CPRIORITY
+#define I2CPRIORITY 1        // the I2C driver only keeps the bus busy briefly
+#endif
+#ifndef I2CIDLEMS
+#define I2CIDLEMS   1000     // msec the I2C driver sleeps with nothing to do
+#endif
+#ifndef EDFPRIORITY
+#define EDFPRIORITY 8        // earliest deadline first threads, kept for OS_AddEDFThread
+#endif
+#ifndef EDFMAXUTIL
+#define EDFMAXUTIL  900000   // ppm of the CPU EDF budgets may claim, the rest is for ISRs
+#endif
+
+// ---------- threads built by the compiler, optional ----------
+// Main threads and periodic event threads may be listed here instead
+// of added with OS_AddThread and OS_AddPeriodicEventThread, by every
+// program that links this os.c.  Their TCBs, the TCB ring, their stacks
+// and the event thread heap are then initialized data; OS_Init only
+// paints each stack, builds its first frame and makes it ready.
+//   #define OSTHREADS(THREAD) THREAD(Task3, 64, 15) THREAD(Task7, 48, 15)
+//   #define OSPERIODIC(EVENT) EVENT(Task0, 1) EVENT(Task1, 100)
+// A THREAD is a void/void function, its stack size in 32-bit words and
+// its priority; it counts against NUMTHREADS and gets the thread ID
+// after the worker's, in the order listed.  An EVENT is a void/void
+// function and its period in msec; it counts against NUMPERIODIC.
+
+// ---------- derived from the settings above, not settings ----------
+#define STACKBLOCK  16       // stacks are handed out in blocks of this many words
+#define FRAMESIZE   18       // words in the initial frame SetInitialStack builds, never painted
+#define MINSTACKSIZE 48      // initial frame plus room for the ISRs that run on every stack
+#define BLOCKS(words) (((words)+STACKBLOCK-1)&~(STACKBLOCK-1)) // rounded up to whole blocks
+#define STACKWORDS  BLOCKS(STACKSIZE)
+#define SYSTEMTHREADS (1+DEFER+I2CDRIVER)  // idle, and the worker and I2C driver if built
+#define STACKPOOLSIZE (THREADSTACKWORDS+MINSTACKSIZE+DEFER*BLOCKS(WORKERSTACKSIZE)+I2CDRIVER*BLOCKS(I2CSTACKSIZE)) // words shared by all stacks
+
+#ifdef OSTHREADS
+#define STATICCOUNT(thread, words, pri) +1
+#define NUMSTATIC   (0 OSTHREADS(STATICCOUNT))  // threads in OSTHREADS
+#if NUMSTATIC > NUMTHREADS
+#error "OSTHREADS lists more than NUMTHREADS threads"
+#endif
+#endif
+#ifdef OSPERIODIC
+#define EVENTCOUNT(thread, period) +1
+#define NUMSTATICEVENTS (0 OSPERIODIC(EVENTCOUNT))  // event threads in OSPERIODIC
+#if NUMSTATICEVENTS > NUMPERIODIC
+#error "OSPERIODIC lists more than NUMPERIODIC event threads"
+#endif
+#endif
+
+#define POWEROF2(n) (((n) > 0) && (((n)&((n)-1)) == 0))
+#if !POWEROF2(NUMWORK) || !POWEROF2(NUMSEMAPHORES) || !POWEROF2(FSIZE) || !POWEROF2(TRACESIZE)
+#error "NUMWORK, NUMSEMAPHORES, FSIZE and TRACESIZE must be powers of 2"
+#endif
+#if THREADSTACKWORDS < NUMTHREADS*STACKWORDS
+#error "THREADSTACKWORDS must hold the NUMTHREADS stacks of OS_AddThreads"
+#endif
+#if (DEFAULTPRIORITY >= IDLEPRIORITY) || (WORKERPRIORITY >= IDLEPRIORITY) || (I2CPRIORITY >= IDLEPRIORITY)
+#error "IDLEPRIORITY belongs to the idle thread"
+#endif
+#if EDF && ((EDFPRIORITY >= IDLEPRIORITY) || (EDFPRIORITY == DEFAULTPRIORITY))
+#error "EDFPRIORITY must be below IDLEPRIORITY and not shared with OS_AddThreads threads"
+#endif
+
+#endif
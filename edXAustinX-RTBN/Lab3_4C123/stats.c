@@ -0,0 +1,133 @@
+// stats.c
+// Runs on LM4F120/TM4C123/MSP432
+// Streaming fixed-point statistics for the Lab 3 sensor tasks.
+// The producer pays a few adds and a multiply per sample; the
+// division and square root are left for whoever reads the result.
+
+#include <stdint.h>
+#include "stats.h"
+#include "dsp.h"
+
+// ******** Stats_Init ************
+// Forget every sample
+// Inputs:  statistics
+// Outputs: none
+void Stats_Init(StatsType *s){
+  s->Count = 0;
+  s->Sum = 0;
+  s->SumSquares = 0;
+  s->Min = INT32_MAX;
+  s->Max = INT32_MIN;
+}
+
+// ******** Stats_Add ************
+// Add one sample, in constant time
+// Inputs:  statistics, sample
+// Outputs: none
+void Stats_Add(StatsType *s, int32_t x){
+  s->Count = s->Count + 1;
+  s->Sum = s->Sum + x;
+  s->SumSquares = s->SumSquares + x*x;  // x*x fits in 32 bits for 16-bit samples
+  if(x < s->Min){
+    s->Min = x;
+  }
+  if(x > s->Max){
+    s->Max = x;
+  }
+}
+
+// ******** Stats_AddBlock ************
+// Add a block of samples; the sums take the dual multiply-accumulate
+// kernels, and only the minimum and maximum look at each sample
+// Inputs:  statistics, samples, number of samples
+// Outputs: none
+void Stats_AddBlock(StatsType *s, const int16_t *x, uint32_t n){
+  uint32_t i;
+  s->Count = s->Count + n;
+  s->Sum = s->Sum + DSP_Sum(x, n);
+  s->SumSquares = s->SumSquares + DSP_SumSquares(x, n);
+  for(i=0; i<n; i=i+1){
+    if(x[i] < s->Min){
+      s->Min = x[i];
+    }
+    if(x[i] > s->Max){
+      s->Max = x[i];
+    }
+  }
+}
+
+// ******** Stats_Mean ************
+// Mean of the samples, truncated toward zero
+// Inputs:  statistics
+// Outputs: mean, 0 if there are no samples
+int32_t Stats_Mean(const StatsType *s){
+  if(s->Count == 0){
+    return 0;
+  }
+  return s->Sum/(int32_t)s->Count;
+}
+
+// ******** Stats_Variance ************
+// Population variance from the two sums,
+// (n*sum(x^2) - sum(x)^2)/n^2, which is exact in 64 bits
+// Inputs:  statistics
+// Outputs: variance, 0 if there are no samples
+uint32_t Stats_Variance(const StatsType *s){
+  int64_t n = s->Count;
+  if(n == 0){
+    return 0;
+  }
+  return (uint32_t)((n*s->SumSquares - (int64_t)s->Sum*s->Sum)/(n*n));
+}
+
+// ******** Stats_RMS ************
+// Root mean square of the samples about their mean,
+// that is the standard deviation, truncated
+// Inputs:  statistics
+// Outputs: RMS, 0 if there are no samples
+uint32_t Stats_RMS(const StatsType *s){
+  return sqrt32(Stats_Variance(s));
+}
+
+// ******** Stats_EWMAInit ************
+// Start an average at a first guess
+// Inputs:  average, weight of each new sample (1 to 1024 out of 1024,
+//          higher discounts older samples faster), first guess
+// Outputs: none
+void Stats_EWMAInit(EWMAType *f, uint32_t alpha, int32_t first){
+  f->Average = first*1024;
+  f->Alpha = alpha;
+}
+
+// ******** Stats_EWMA ************
+// average = average + alpha*(x - average)/1024, with the average
+// kept in 1/1024 units so small steps toward x are not lost
+// Inputs:  average, sample
+// Outputs: new average
+int32_t Stats_EWMA(EWMAType *f, int32_t x){
+  f->Average = f->Average + (int32_t)(((int64_t)(x*1024 - f->Average)*(int32_t)f->Alpha)/1024);
+  return (f->Average + 512)>>10; // round to nearest, >> is arithmetic on signed
+}
+
+// ******** sqrt32 ************
+// Integer square root by Newton's method
+// t + s/t is the same as (t*t+s)/t but can not overflow.  After the
+// first step t is at least the root; stop when t stops shrinking,
+// rather than after a fixed count, so the result never ends one high.
+// Inputs:  s
+// Outputs: square root of s, rounded down
+uint32_t sqrt32(uint32_t s){
+uint32_t t;   // t*t will become s
+uint32_t next;     // t after one more step
+  if(s == 0){
+    return 0;      // the first step would reach 0 and divide by it
+  }
+  t = s/16+1;      // initial guess
+  t = (t + s/t)/2;
+  next = (t + s/t)/2;
+  while(next < t){ // will finish, t shrinks every time
+    t = next;
+    next = (t + s/t)/2;
+  }
+  return t;
+}
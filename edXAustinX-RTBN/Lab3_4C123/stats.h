@@ -0,0 +1,91 @@
+// stats.h
+// Runs on LM4F120/TM4C123/MSP432
+// Streaming fixed-point statistics for the Lab 3 sensor tasks.
+// Each sample updates the running mean, variance, minimum, maximum
+// or exponentially weighted moving average in constant time, so a
+// reader gets results without rescanning a buffer of samples.
+
+#ifndef __STATS_H
+#define __STATS_H  1
+
+#include <stdint.h>
+
+// ******** StatsType ************
+// Running statistics of samples from -32768 to 32767, exact
+// for up to 65536 samples between calls to Stats_Init
+struct stats{
+  uint32_t Count;      // samples added since Stats_Init
+  int32_t  Sum;        // of the samples
+  int64_t  SumSquares; // of the squares of the samples
+  int32_t  Min;        // smallest sample, INT32_MAX if none
+  int32_t  Max;        // largest sample, INT32_MIN if none
+};
+typedef struct stats StatsType;
+
+// ******** Stats_Init ************
+// Forget every sample
+// Inputs:  statistics
+// Outputs: none
+void Stats_Init(StatsType *s);
+
+// ******** Stats_Add ************
+// Add one sample, in constant time
+// Inputs:  statistics, sample
+// Outputs: none
+void Stats_Add(StatsType *s, int32_t x);
+
+// ******** Stats_AddBlock ************
+// Add a block of samples, the sums with the dsp.c kernels
+// Inputs:  statistics, samples, number of samples
+// Outputs: none
+void Stats_AddBlock(StatsType *s, const int16_t *x, uint32_t n);
+
+// ******** Stats_Mean ************
+// Mean of the samples, truncated toward zero
+// Inputs:  statistics
+// Outputs: mean, 0 if there are no samples
+int32_t Stats_Mean(const StatsType *s);
+
+// ******** Stats_Variance ************
+// Population variance of the samples, truncated
+// Inputs:  statistics
+// Outputs: variance, 0 if there are no samples
+uint32_t Stats_Variance(const StatsType *s);
+
+// ******** Stats_RMS ************
+// Root mean square of the samples about their mean,
+// that is the standard deviation, truncated
+// Inputs:  statistics
+// Outputs: RMS, 0 if there are no samples
+uint32_t Stats_RMS(const StatsType *s);
+
+// ******** EWMAType ************
+// Exponentially weighted moving average of samples
+// from -1048576 to 1048575, kept with 10 fraction bits
+// https://en.wikipedia.org/wiki/Moving_average#Exponential_moving_average
+struct ewma{
+  int32_t  Average;    // 1024 times the average
+  uint32_t Alpha;      // weight of each new sample, 1 to 1024 out of 1024
+};
+typedef struct ewma EWMAType;
+
+// ******** Stats_EWMAInit ************
+// Start an average at a first guess
+// Inputs:  average, weight of each new sample (1 to 1024 out of 1024,
+//          higher discounts older samples faster), first guess
+// Outputs: none
+void Stats_EWMAInit(EWMAType *f, uint32_t alpha, int32_t first);
+
+// ******** Stats_EWMA ************
+// Add one sample to an average, in constant time
+// Inputs:  average, sample
+// Outputs: new average
+int32_t Stats_EWMA(EWMAType *f, int32_t x);
+
+// ******** sqrt32 ************
+// Integer square root by Newton's method
+// Inputs:  s
+// Outputs: square root of s, rounded down
+uint32_t sqrt32(uint32_t s);
+
+#endif